@@ -2,15 +2,12 @@
 layout (location = 0) in vec3 vPos;
 layout (location = 1) in vec3 vNor;
 layout (location = 2) in vec2 vTex;
+layout (location = 3) in mat4 iModelViewProjection;
 
 out float outColor;
 out vec2 texCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
 void main(){
-    gl_Position = projection * view * model * vec4(vPos, 1);
+    gl_Position = iModelViewProjection * vec4(vPos, 1);
     texCoord = vTex;
 }
\ No newline at end of file
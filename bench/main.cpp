@@ -0,0 +1,335 @@
+#include "glWrapper.hpp"
+
+#include <chrono>
+#include <random>
+
+// CPU benchmarks of glWrap systems, none of them need a GL context
+
+static double Milliseconds(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static glWrap::Mesh MakeBoxMesh(){ // Unit cube with CPU data only
+    glWrap::Mesh mesh;
+    glWrap::Primitive primitive;
+
+    for (int corner{}; corner < 8; ++corner){
+        primitive.m_vertices.push_back({{corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f}});
+    }
+
+    primitive.m_indices = {0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,  0, 4, 5, 0, 5, 1,
+                           2, 3, 7, 2, 7, 6,  0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3};
+
+    mesh.m_primitives.push_back(primitive);
+    mesh.ComputeBounds();
+    return mesh;
+}
+
+static void BenchFrustumCulling(){
+    const size_t count = 1000000;
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+    std::vector<glWrap::AABB> boxes(count);
+    glWrap::BoxList list;
+
+    for (glWrap::AABB& box : boxes){
+        glm::vec3 center{position(random), position(random), position(random)};
+        glm::vec3 extent{size(random), size(random), size(random)};
+        box = {center - extent, center + extent};
+        list.Add(box);
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    glWrap::Frustum frustum(projection * view);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t scalarVisible{};
+    for (const glWrap::AABB& box : boxes) scalarVisible += frustum.Intersects(box);
+    double scalarTime = Milliseconds(start);
+
+    std::vector<unsigned char> visible;
+    start = std::chrono::steady_clock::now();
+    frustum.Cull(list, visible);
+    double batchTime = Milliseconds(start);
+
+    size_t batchVisible{};
+    for (unsigned char value : visible) batchVisible += value;
+
+    std::cout << "Frustum culling, " << count << " boxes\n";
+    std::cout << "    per box:  " << scalarTime << " ms, " << scalarVisible << " visible\n";
+    std::cout << "    batched:  " << batchTime << " ms, " << batchVisible << " visible\n";
+}
+
+static void BenchSceneCulling(){
+    glWrap::Mesh mesh; // Bounds only, culling never touches GL objects
+    mesh.m_bounds = {glm::vec3(-1.0f), glm::vec3(1.0f)};
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    glWrap::Frustum frustum(projection * view);
+
+    std::cout << "Scene culling, world of 2000 units, 200 unit view distance\n";
+
+    for (size_t count : {10000, 100000, 1000000}){
+        std::mt19937 random(2);
+        std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+
+        std::vector<glWrap::Instance> instances(count);
+        glWrap::Scene scene;
+        glWrap::BoxList list;
+
+        for (glWrap::Instance& instance : instances){
+            instance.SetMesh(&mesh);
+            instance.SetPosition({position(random), position(random) * 0.05f, position(random)});
+            scene.Add(&instance);
+            list.Add(instance.GetWorldBounds());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        scene.Update();
+        double buildTime = Milliseconds(start);
+
+        std::vector<glWrap::Instance*> visible;
+        start = std::chrono::steady_clock::now();
+        scene.Cull(frustum, visible);
+        double treeTime = Milliseconds(start);
+
+        std::vector<unsigned char> results;
+        start = std::chrono::steady_clock::now();
+        frustum.Cull(list, results);
+        double linearTime = Milliseconds(start);
+
+        size_t linearVisible{};
+        for (unsigned char value : results) linearVisible += value;
+
+        std::cout << "    " << count << " instances: build " << buildTime << " ms, tree " << treeTime << " ms (" << visible.size()
+                  << " visible), linear " << linearTime << " ms (" << linearVisible << " visible)\n";
+    }
+}
+
+static void BenchOcclusionCulling(){
+    glWrap::Mesh box = MakeBoxMesh();
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 2.0f, 0.1f, 500.0f);
+    glm::mat4 viewProjection = projection * view;
+    glWrap::Frustum frustum(viewProjection);
+
+    // A row of building sized walls in front of the camera, with gaps between them
+    std::vector<glm::mat4> walls;
+    for (int i{-6}; i <= 6; ++i){
+        glm::mat4 wall = glm::translate(glm::mat4(1.0f), glm::vec3(i * 14.0f, 0.0f, -30.0f));
+        walls.push_back(glm::scale(wall, glm::vec3(6.0f, 20.0f, 1.0f)));
+    }
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> x(-300.0f, 300.0f), y(-15.0f, 15.0f), z(-400.0f, -1.0f);
+
+    std::vector<glWrap::AABB> boxes;
+    while (boxes.size() < 100000){
+        glm::vec3 center{x(random), y(random), z(random)};
+        glWrap::AABB candidate{center - glm::vec3(1.0f), center + glm::vec3(1.0f)};
+        if (frustum.Intersects(candidate)) boxes.push_back(candidate);
+    }
+
+    std::cout << "Occlusion culling, " << walls.size() << " walls, " << boxes.size() << " boxes in the frustum\n";
+
+    for (unsigned int threads : {1u, std::max(1u, std::thread::hardware_concurrency())}){
+        glWrap::JobSystem jobs(threads);
+        glWrap::OcclusionBuffer buffer({256, 128}, &jobs);
+
+        auto start = std::chrono::steady_clock::now();
+        buffer.Clear(viewProjection);
+        for (const glm::mat4& wall : walls) buffer.AddOccluder(box, wall);
+        double binTime = Milliseconds(start);
+
+        buffer.Rasterize();
+
+        start = std::chrono::steady_clock::now();
+        size_t hidden{};
+        for (const glWrap::AABB& candidate : boxes) hidden += !buffer.IsVisible(candidate);
+        double testTime = Milliseconds(start);
+
+        std::cout << "    " << threads << " threads: bin " << binTime << " ms, raster " << buffer.GetRasterTime() << " ms, test " << testTime
+                  << " ms, culled " << hidden << " (" << 100.0 * hidden / boxes.size() << "%)\n";
+    }
+}
+
+static void BenchTransforms(){
+    const size_t count = 1000000;
+
+    std::mt19937 random(4);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f), angle(-720.0f, 720.0f), scale(0.1f, 4.0f);
+
+    std::vector<glWrap::Transform> transforms(count);
+    for (glWrap::Transform& transform : transforms){
+        transform = {{position(random), position(random), position(random)}, {angle(random), angle(random), angle(random)}, {scale(random), scale(random), scale(random)}};
+    }
+
+    auto megaPerSecond = [count](double ms){ return count / ms / 1000.0; };
+
+    // The translate, scale and three rotate chain GetTransformMatrix used before
+    std::vector<glm::mat4> reference(count);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i{}; i < count; ++i){
+        const glWrap::Transform& transform = transforms[i];
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.pos);
+        model = glm::scale(model, transform.scl);
+        model = glm::rotate(model, glm::radians(transform.rot.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(transform.rot.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        reference[i] = glm::rotate(model, glm::radians(transform.rot.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+    double chainTime = Milliseconds(start);
+
+    std::vector<glm::mat4> composed(count);
+    start = std::chrono::steady_clock::now();
+    glWrap::TransformBatch::Compose(transforms.data(), composed.data(), count);
+    double composeTime = Milliseconds(start);
+
+    glWrap::TransformBatch batch;
+    for (const glWrap::Transform& transform : transforms) batch.Add(transform);
+
+    start = std::chrono::steady_clock::now();
+    batch.Update();
+    double batchTime = Milliseconds(start);
+
+    // Only a tenth of the objects move, dirty flags are kept per block of neighbours
+    for (size_t i{}; i < count / 10; ++i) batch.SetPosition(i, transforms[i].pos + glm::vec3(1.0f));
+    start = std::chrono::steady_clock::now();
+    batch.Update();
+    double partialTime = Milliseconds(start);
+
+    float error{};
+    for (size_t i{}; i < count; ++i){
+        for (int column{}; column < 3; ++column){ // The batch moved some translations
+            error = std::max(error, glm::length(reference[i][column] - composed[i][column]));
+            error = std::max(error, glm::length(reference[i][column] - batch.GetMatrix(i)[column]));
+        }
+    }
+
+    std::cout << "Transform matrices, " << count << " objects\n"
+              << "    glm chain: " << chainTime << " ms (" << megaPerSecond(chainTime) << " M/s)\n"
+              << "    compose:   " << composeTime << " ms (" << megaPerSecond(composeTime) << " M/s)\n"
+              << "    batch:     " << batchTime << " ms (" << megaPerSecond(batchTime) << " M/s), a tenth dirty " << partialTime << " ms\n"
+              << "    max error: " << error << '\n';
+}
+
+static std::vector<unsigned int> ThreadCounts(){ // Powers of two up to the hardware thread count
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> counts;
+    for (unsigned int threads{1}; threads < cores; threads *= 2) counts.push_back(threads);
+    counts.push_back(cores);
+    return counts;
+}
+
+static void BenchJobScaling(){
+    const size_t count = 4000000;
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f), size(0.5f, 5.0f);
+
+    glWrap::BoxList list;
+    for (size_t i{}; i < count; ++i){
+        glm::vec3 center{position(random), position(random), position(random)};
+        glm::vec3 extent{size(random), size(random), size(random)};
+        list.Add({center - extent, center + extent});
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    glWrap::Frustum frustum(projection * view);
+
+    glWrap::TransformBatch batch;
+    std::uniform_real_distribution<float> angle(-720.0f, 720.0f), scale(0.1f, 4.0f);
+    for (size_t i{}; i < count / 4; ++i){
+        batch.Add({{position(random), position(random), position(random)}, {angle(random), angle(random), angle(random)}, {scale(random), scale(random), scale(random)}});
+    }
+
+    // The same file many times over, the way a level pulls in its props
+    std::vector<std::string> files(64, "../assets/Cube.gltf");
+
+    std::cout << "Job system scaling, " << count << " boxes culled, " << batch.Size() << " transforms, " << files.size() << " glTF imports\n";
+
+    double cullBase{}, transformBase{}, importBase{};
+
+    for (unsigned int threads : ThreadCounts()){
+        glWrap::JobSystem jobs(threads);
+
+        std::vector<unsigned char> visible;
+        auto start = std::chrono::steady_clock::now();
+        frustum.Cull(list, visible, jobs);
+        double cullTime = Milliseconds(start);
+
+        for (size_t i{}; i < batch.Size(); ++i) batch.SetScale(i, batch.Get(i).scl);
+        start = std::chrono::steady_clock::now();
+        batch.Update(jobs);
+        double transformTime = Milliseconds(start);
+
+        glWrap::JobCounter counter;
+        std::vector<size_t> meshes(files.size());
+        start = std::chrono::steady_clock::now();
+        for (size_t i{}; i < files.size(); ++i){
+            jobs.Run([&, i](){ meshes[i] = glWrap::Window::ImportFile(files[i], jobs).size(); }, &counter);
+        }
+        jobs.Wait(counter);
+        double importTime = Milliseconds(start);
+
+        if (threads == 1){
+            cullBase = cullTime;
+            transformBase = transformTime;
+            importBase = importTime;
+        }
+
+        std::cout << "    " << threads << " threads: cull " << cullTime << " ms (x" << cullBase / cullTime << "), transforms " << transformTime
+                  << " ms (x" << transformBase / transformTime << "), import " << importTime << " ms (x" << importBase / importTime << ")\n";
+    }
+}
+
+static void BenchTextureCooking(){
+    const int size = 1024;
+
+    std::mt19937 random(6);
+    std::vector<unsigned char> image((size_t)size * size * 4);
+    for (size_t i{}; i < image.size(); ++i) image[i] = (unsigned char)((i / 4 % size) / 4 + random() % 32);
+
+    std::cout << "Texture cooking, " << size << "x" << size << " sRGB image\n";
+
+    for (unsigned int threads : ThreadCounts()){
+        glWrap::JobSystem jobs(threads);
+        glWrap::TextureCooker cooker(jobs);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::vector<unsigned char>> box = cooker.GenerateMips(image.data(), {size, size}, glWrap::TextureCooker::Filter::Box, true);
+        double boxTime = Milliseconds(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<std::vector<unsigned char>> levels = cooker.GenerateMips(image.data(), {size, size}, glWrap::TextureCooker::Filter::Kaiser, true);
+        double kaiserTime = Milliseconds(start);
+
+        std::cout << "    " << threads << " threads: box mips " << boxTime << " ms, kaiser mips " << kaiserTime << " ms";
+
+        for (glWrap::TextureCooker::Encoding encoding : {glWrap::TextureCooker::Encoding::BC1, glWrap::TextureCooker::Encoding::BC3, glWrap::TextureCooker::Encoding::BC7}){
+            start = std::chrono::steady_clock::now();
+            cooker.Encode(levels, {size, size}, encoding, true);
+            std::cout << ", BC" << (encoding == glWrap::TextureCooker::Encoding::BC1 ? 1 : encoding == glWrap::TextureCooker::Encoding::BC3 ? 3 : 7)
+                      << " " << Milliseconds(start) << " ms";
+        }
+
+        std::cout << '\n';
+    }
+}
+
+int main(){
+    BenchFrustumCulling();
+    BenchSceneCulling();
+    BenchOcclusionCulling();
+    BenchTransforms();
+    BenchJobScaling();
+    BenchTextureCooking();
+
+    return 0;
+}
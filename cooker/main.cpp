@@ -0,0 +1,42 @@
+#include "glWrapper.hpp"
+
+#include <chrono>
+
+// Cooks images into KTX2 files next to them, needs no GL context
+//   textureCooker [--box | --kaiser] [--rgba8 | --bc1 | --bc3 | --bc7] [--linear] [--flip] images...
+
+int main(int argc, char** argv){
+    glWrap::TextureCooker::Settings settings;
+    std::vector<std::pair<std::string, std::string>> files;
+
+    for (int i{1}; i < argc; ++i){
+        std::string argument = argv[i];
+
+        if (argument == "--box") settings.filter = glWrap::TextureCooker::Filter::Box;
+        else if (argument == "--kaiser") settings.filter = glWrap::TextureCooker::Filter::Kaiser;
+        else if (argument == "--rgba8") settings.encoding = glWrap::TextureCooker::Encoding::RGBA8;
+        else if (argument == "--bc1") settings.encoding = glWrap::TextureCooker::Encoding::BC1;
+        else if (argument == "--bc3") settings.encoding = glWrap::TextureCooker::Encoding::BC3;
+        else if (argument == "--bc7") settings.encoding = glWrap::TextureCooker::Encoding::BC7;
+        else if (argument == "--linear") settings.srgb = false;
+        else if (argument == "--flip") settings.flip = true;
+        else if (argument.rfind("--", 0) == 0){
+            std::cout << "Unknown option " << argument << '\n';
+            return 1;
+        }
+        else files.emplace_back(argument, argument.substr(0, argument.find_last_of('.')) + ".ktx2");
+    }
+
+    if (files.empty()){
+        std::cout << "Usage: textureCooker [--box | --kaiser] [--rgba8 | --bc1 | --bc3 | --bc7] [--linear] [--flip] images...\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    glWrap::TextureCooker cooker;
+    size_t cooked = cooker.Cook(files, settings);
+
+    std::cout << "Cooked " << cooked << " of " << files.size() << " textures in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+    return cooked == files.size() ? 0 : 1;
+}
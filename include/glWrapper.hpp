@@ -2,17 +2,30 @@
 
 #include <string>
 #include <fstream>
+#include <sstream>
 #include <iostream>
 #include <array>
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <map>
+#include <tuple>
 
 #include "gl/glad.h"
 #include "gl/glfw3.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
+#include "glm/gtc/quaternion.hpp"
 #include "tinygltf/tinygltf.hpp"
 #include "tinygltf/stb_image.h"
 
@@ -37,12 +50,242 @@ namespace glWrap
         glm::vec3 scl{};
     };
 
+    class JobSystem;
+
+    // Counts the unfinished jobs started with it, jobs can also wait for one to reach zero
+    class JobCounter{
+    private:
+        friend class JobSystem;
+
+        std::atomic<int>                                        m_value{0};
+        std::mutex                                              m_mutex;
+        std::vector<std::pair<std::function<void()>, JobCounter*>> m_waiting; // Started when the count reaches zero
+
+    public:
+        bool IsDone() const;
+    };
+
+    // Work stealing scheduler. Every worker owns a deque, takes its newest job first and steals the
+    // oldest jobs of the others when it runs dry. Threads outside the system, like the main thread,
+    // queue into a shared deque and run jobs while they wait.
+    class JobSystem{
+    private:
+        struct Queue{
+            std::mutex                                              mutex;
+            std::deque<std::pair<std::function<void()>, JobCounter*>> jobs;
+        };
+
+        std::vector<std::unique_ptr<Queue>>     m_queues;   // Shared deque first, then one per worker
+        Queue                                   m_background;
+        std::vector<std::thread>                m_workers;
+        std::atomic<int>                        m_queued{0};
+        std::atomic<int>                        m_sleeping{0};
+        std::atomic<bool>                       m_stopping{false};
+        std::mutex                              m_sleepMutex;
+        std::condition_variable                 m_wake;
+
+        void Push(std::function<void()> job, JobCounter* counter);
+        bool RunOne(unsigned int queue);
+        void Finish(JobCounter* counter);
+        void WorkerLoop(unsigned int queue);
+        unsigned int GetQueueIndex();
+
+    public:
+        /** @brief JobSystem Constructor
+         *@param[in] threads Threads running jobs including the waiting caller, 0 for one per hardware thread
+         */
+        JobSystem(unsigned int threads = 0);
+        ~JobSystem();
+
+        /** @brief System shared by every glWrap class that isn't given one */
+        static JobSystem& Default();
+
+        /** @brief Queues a job
+         *@param[in] job Function to run on any thread of the system
+         *@param[in] counter Incremented now and decremented once the job finished, optional
+         *@param[in] dependency The job is only queued after this counter reached zero, optional
+         */
+        void Run(std::function<void()> job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+        /** @brief Queues a long job only the workers take, so threads waiting on short jobs never pick it up.
+         * Runs at once on the caller when the system has no workers
+         */
+        void RunBackground(std::function<void()> job, JobCounter* counter = nullptr);
+
+        /** @brief Runs queued jobs on the calling thread until the counter reached zero */
+        void Wait(JobCounter& counter);
+
+        /** @brief Splits [0, count) into ranges of at least grain items, runs them as jobs and waits
+         *@param[in] body Called with the begin and end of every range
+         */
+        void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+        unsigned int GetThreadCount(); // Workers plus the waiting caller
+    };
+
+    // Axis aligned bounding box, empty until a point is added
+    struct AABB{
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{-std::numeric_limits<float>::max()};
+
+        bool IsEmpty() const;
+        glm::vec3 GetCenter() const;
+        glm::vec3 GetExtent() const;
+        void Expand(glm::vec3 point);
+        void Expand(const AABB& box);
+
+        /** @brief Box enclosing this box after transformation */
+        AABB Transformed(const glm::mat4& matrix) const;
+    };
+
+    // Boxes stored as separate center and extent arrays, so they can be tested several at a time
+    class BoxList{
+    public:
+        std::vector<float> m_cx, m_cy, m_cz;
+        std::vector<float> m_ex, m_ey, m_ez;
+
+        void Add(const AABB& box);
+        void Clear();
+        size_t Size() const;
+    };
+
+    class Frustum{
+    private:
+        glm::vec4 m_planes[6]{}; // Inward facing, xyz normal and w distance
+
+    public:
+        Frustum() = default; // Contains everything
+
+        /** @brief Extracts the six clip planes of a view projection matrix */
+        Frustum(const glm::mat4& viewProjection);
+
+        bool Intersects(const AABB& box) const;
+
+        /** @brief -1 if the box is outside, 0 if it crosses a plane and 1 if it is fully inside */
+        int Classify(const AABB& box) const;
+
+        /** @brief Tests every box against the planes, 4 or 8 boxes per iteration with SSE or AVX
+         *@param[in] boxes Boxes to test
+         *@param[out] visible Resized to the box count, 1 for boxes at least partially inside
+         */
+        void Cull(const BoxList& boxes, std::vector<unsigned char>& visible) const;
+
+        /** @brief Cull with the boxes split over the jobs of a system */
+        void Cull(const BoxList& boxes, std::vector<unsigned char>& visible, JobSystem& jobs) const;
+
+        /** @brief Tests the boxes [begin, end), visible must already hold the box count */
+        void Cull(const BoxList& boxes, std::vector<unsigned char>& visible, size_t begin, size_t end) const;
+
+        const glm::vec4* GetPlanes() const;
+    };
+
+    // Mirror of the GL binding state of the context current on the calling thread.
+    // Every glWrap class binds through it so calls that wouldn't change anything are dropped.
+    class StateCache
+    {
+    public:
+        static const unsigned int maxUnits = 32;
+
+        struct Stats{
+            unsigned int issued;
+            unsigned int filtered;
+        };
+
+    private:
+        static const GLuint unknown = 0xFFFFFFFF; // Never matches a real name or enum
+
+        GLuint                                  m_program;
+        GLuint                                  m_vertexArray;
+        std::vector<std::pair<GLenum, GLuint>>  m_buffers;
+        unsigned int                            m_activeUnit;
+        std::array<GLuint, maxUnits>            m_textures2D;
+        std::array<GLuint, maxUnits>            m_texturesArray;
+        std::array<GLuint, maxUnits>            m_samplers;
+        std::vector<std::pair<GLenum, bool>>    m_capabilities;
+        GLuint                                  m_depthMask;
+        GLenum                                  m_blendSrc,
+                                                m_blendDst;
+        glm::ivec4                              m_viewport;
+        Stats                                   m_stats{};
+
+        bool Filter(bool redundant);
+        GLuint* TextureSlot(unsigned int unit, GLenum target);
+
+    public:
+        StateCache();
+
+        /** @brief Cache of the calling thread, each thread has at most one current context */
+        static StateCache& Current();
+
+        /** @brief Forgets all cached state, call after making a context current or after raw GL calls */
+        void Invalidate();
+
+        void UseProgram(GLuint program);
+        void BindVertexArray(GLuint vertexArray);
+        void BindBuffer(GLenum target, GLuint buffer);
+        void BindTexture(unsigned int unit, GLenum target, GLuint texture);
+        void BindSampler(unsigned int unit, GLuint sampler);
+        void SetCapability(GLenum capability, bool enabled);
+        void SetDepthMask(bool enabled);
+        void SetBlendFunc(GLenum source, GLenum destination);
+        void SetViewport(glm::ivec4 viewport);
+
+        // Deleted names are unbound by GL and may be reused, so they must leave the cache
+        void DeleteProgram(GLuint program);
+        void DeleteVertexArray(GLuint vertexArray);
+        void DeleteBuffer(GLuint buffer);
+        void DeleteTexture(GLuint texture);
+        void DeleteSampler(GLuint sampler);
+
+        Stats GetStats();
+        void ResetStats();
+    };
+
+    // How a texture is filtered and wrapped, kept out of the texture in a GL sampler object
+    struct SamplerState{
+        GLenum  minFilter{GL_LINEAR};
+        GLenum  magFilter{GL_LINEAR};
+        GLenum  wrapS{GL_REPEAT};
+        GLenum  wrapT{GL_REPEAT};
+        float   anisotropy{1.0f};   // Above one where the context supports anisotropic filtering
+
+        bool operator<(const SamplerState& other) const;
+    };
+
+    // One GL sampler object per distinct SamplerState, shared by all textures. Samplers aren't
+    // container objects, so the contexts sharing with the window use the same names.
+    class SamplerCache{
+    public:
+        /** @brief Sampler of the state, created on first use. Needs the context or one sharing with it */
+        static GLuint Get(const SamplerState& state);
+
+        /** @brief Deletes every sampler, on the context thread before the context goes */
+        static void Clear();
+        static size_t Size();
+    };
+
+    // Owns its GL texture, deleted with the object. Move only, share it through TextureCache.
+    // Storage is immutable where glTexStorage2D exists, sampling state lives in a shared sampler.
     class Texture2D
     {
+        private:
+        SamplerState    m_samplerState;
+        GLuint          m_sampler{};
+        bool            m_immutable{false};
+
         public:
-        unsigned int m_ID;
+        // Mip chain of a DDS or KTX2 file, block compressed or plain RGBA8
+        struct Compressed{
+            GLenum                                  format{};   // GL compressed internal format, or GL_RGBA8 / GL_SRGB8_ALPHA8
+            glm::ivec2                              size{};
+            std::vector<std::vector<unsigned char>> levels;     // Largest first
+        };
+
+        unsigned int m_ID{};
 
-        /** @brief Texture2D Constructor 
+        /** @brief Texture2D Constructor. DDS and KTX2 files holding BC1, BC3, BC4, BC5, BC7 or ETC2 blocks are
+         * uploaded compressed with their mip chain, or decompressed on the CPU where the context lacks the format.
+         * Their flip and channels are fixed by the file
          *@param[in] image String path to image location on disk
          *@param[in] flip If image should be vertically flipped
          *@param[in] filter Select pixel interpolation: GL_LINEAR or GL_NEAREST
@@ -50,22 +293,390 @@ namespace glWrap
          */
         Texture2D(std::string image, bool flip, GLenum filter, GLenum desiredChannels);
 
-        /** @brief Description
+        /** @brief Single pixel texture of one colour, the stand in of textures still loading */
+        Texture2D(glm::u8vec4 color, GLenum filter);
+
+        /** @brief Reads a DDS or KTX2 file
+         *@return False if the file isn't one or holds a format that can't be read
+         */
+        static bool ReadCompressed(const std::string& path, Compressed& image);
+        static bool IsCompressedFile(const std::string& path); // By extension
+
+        /** @brief Writes the image as a KTX2 file, the format must be RGBA8, BC1 RGB, BC3 or BC7 */
+        static bool WriteCompressed(const std::string& path, const Compressed& image);
+
+        /** @brief Replaces the texture with the levels of the image
+         *@param[in] firstLevel Finest level uploaded, it becomes level 0 of the texture
+         *@return False if a level's format can't be decoded
+         */
+        bool Upload(const Compressed& image, int firstLevel = 0);
+
+        /** @brief Fills one level of storage Allocate made for the image and leaves the texture bound to unit 0
+         *@param[in] level Level of the image, it goes to level level - firstLevel of the texture
+         *@return False if the format can't be decoded
+         */
+        bool UploadLevel(const Compressed& image, int level, int firstLevel = 0);
+
+        /** @brief Gives the texture uninitialized storage for its levels and leaves it bound to unit 0.
+         * Immutable storage can't be replaced, so textures that already have it get a new name
+         *@param[in] format Internal format, unsized formats get their 8 bit sized one
+         */
+        void Allocate(GLenum format, glm::ivec2 size, int levels);
+
+        /** @brief How the texture is sampled unless a shader overrides it, needs the context */
+        void SetSampler(const SamplerState& sampler);
+        const SamplerState& GetSampler() const;
+        unsigned int GetSamplerID() const; // Sampler object, shared by textures of the same state
+
+        Texture2D(const Texture2D&) = delete;
+        Texture2D& operator=(const Texture2D&) = delete;
+        Texture2D(Texture2D&& other) noexcept;
+        Texture2D& operator=(Texture2D&& other) noexcept;
+        ~Texture2D(); // Needs the context, or one sharing with it, to be current
+
+        /** @brief Binds the texture and its sampler
          *@param[in] unit GL Texture Unit
          */
         void SetActive(unsigned int unit);
     };
 
+    // Layers of equal sized RGBA images behind one texture name, sampled with sampler2DArray
+    class Texture2DArray{
+    private:
+        glm::ivec2      m_size{};
+        int             m_layers{};
+        SamplerState    m_samplerState;
+        GLuint          m_sampler{};
+
+    public:
+        unsigned int m_ID{};
+
+        /** @brief Allocates the layers and their mip levels, filled by SetLayer
+         *@param[in] size Width and height of every layer
+         *@param[in] filter GL_LINEAR or GL_NEAREST, mipmapped when mipmaps is set
+         */
+        Texture2DArray(glm::ivec2 size, int layers, GLenum filter, bool mipmaps = true);
+
+        /** @brief Writes RGBA8 pixels into part of a layer, rows bottom up like Texture2D
+         *@param[in] offset Lower left corner of the written rectangle
+         */
+        void SetLayer(int layer, const unsigned char* pixels, glm::ivec2 size, glm::ivec2 offset = {0, 0});
+        void GenerateMipmaps(); // After the layers are written
+
+        glm::ivec2 GetSize() const;
+        int GetLayerCount() const;
+        void SetSampler(const SamplerState& sampler); // Needs the context
+        const SamplerState& GetSampler() const;
+        unsigned int GetSamplerID() const; // Sampler object, shared by textures of the same state
+
+        Texture2DArray(const Texture2DArray&) = delete;
+        Texture2DArray& operator=(const Texture2DArray&) = delete;
+        Texture2DArray(Texture2DArray&& other) noexcept;
+        Texture2DArray& operator=(Texture2DArray&& other) noexcept;
+        ~Texture2DArray();
+
+        void SetActive(unsigned int unit);
+    };
+
+    // Loads textures without blocking the frame. Images decode as background jobs while the returned
+    // texture holds a placeholder pixel. Update then copies decoded pixels into a pixel buffer, at most
+    // the frame budget per call, and specifies the texture from it once the whole image arrived.
+    class TextureLoader{
+    private:
+        struct Request{
+            std::shared_ptr<Texture2D>  texture;
+            std::string                 image;
+            GLenum                      format;
+            std::atomic<int>            state{0};   // 0 decoding, 1 decoded, -1 failed
+            unsigned char*              pixels{nullptr};
+            int                         width{}, height{}, channels{};
+            size_t                      written{};  // Bytes already in the buffer
+            GLuint                      buffer{};
+            Texture2D::Compressed       compressed; // Read instead of pixels for DDS and KTX2 files
+            int                         level{-1};  // Next compressed level to upload, counting down. -1 before allocating
+
+            ~Request();
+        };
+
+        JobSystem*                              m_jobs;
+        size_t                                  m_frameBudget;
+        glm::u8vec4                             m_placeholder{255, 0, 255, 255};
+        std::vector<std::shared_ptr<Request>>   m_requests;
+
+    public:
+        /** @brief TextureLoader Constructor
+         *@param[in] jobs System decoding the images, the default system when null
+         *@param[in] frameBudget Bytes copied towards the GPU per Update
+         */
+        TextureLoader(JobSystem* jobs = nullptr, size_t frameBudget = 4 << 20);
+
+        /** @brief Starts decoding an image, needs the context
+         *@return Texture showing the placeholder colour until the image is uploaded, same parameters as Texture2D
+         */
+        std::shared_ptr<Texture2D> Load(std::string image, bool flip, GLenum filter, GLenum desiredChannels);
+
+        /** @brief Streams an image into an existing texture, which keeps its content until then */
+        void Load(std::shared_ptr<Texture2D> texture, std::string image, bool flip, GLenum desiredChannels);
+
+        /** @brief Moves decoded images to the GPU within the budget, call once a frame on the context thread */
+        void Update();
+
+        /** @brief Drops pending loads and their buffers, their textures keep the placeholder */
+        void Release();
+
+        void SetFrameBudget(size_t bytes);
+        void SetPlaceholderColor(glm::u8vec4 color);
+        glm::u8vec4 GetPlaceholderColor();
+        void SetJobSystem(JobSystem& jobs);
+        size_t GetPending(); // Loads not yet uploaded
+        bool IsReady(const Texture2D* texture);
+    };
+
+    // Shares textures loaded with the same path, flip, filter and format. Handles are reference counted,
+    // when the last one goes, on any thread, the GL texture is queued and deleted by the next Collect.
+    class TextureCache{
+    private:
+        using Key = std::tuple<std::string, bool, GLenum, GLenum>;
+
+        struct Released{
+            std::mutex          mutex;
+            std::vector<GLuint> textures;
+        };
+
+        std::map<Key, std::weak_ptr<Texture2D>> m_entries;
+        std::shared_ptr<Released>               m_released{std::make_shared<Released>()}; // Outlives the cache in deleters
+
+        std::shared_ptr<Texture2D> Share(Texture2D* texture);
+
+    public:
+        /** @brief Texture of the image, loaded on the first request. Same parameters as Texture2D, needs the context
+         *@param[in] loader Streams a new texture in through the loader instead of loading it at once, optional
+         */
+        std::shared_ptr<Texture2D> Get(std::string image, bool flip, GLenum filter, GLenum desiredChannels, TextureLoader* loader = nullptr);
+
+        /** @brief Deletes the textures released since the last call, on the context thread */
+        void Collect();
+
+        /** @brief Collect without forgetting expired entries, safe beside the other calls on another thread */
+        void DeleteReleased();
+        size_t Size(); // Textures still in use
+    };
+
+    // Packs many images into the layers of one Texture2DArray so draws using different images share a
+    // bind. Images are placed on a skyline, tallest first, opening a new layer when one fills up, and are
+    // surrounded by copies of their edge pixels so filtering and mipmaps don't bleed between neighbours.
+    class TextureAtlas{
+    public:
+        struct Entry{
+            int         layer{};
+            glm::vec4   uv{};       // Lower left and upper right texture coordinates
+            glm::ivec4  rect{};     // Pixel position and size in the layer
+        };
+
+    private:
+        struct Image{
+            std::string                 name;
+            std::vector<unsigned char>  pixels{};
+            glm::ivec2                  size{};
+        };
+
+        glm::ivec2                      m_size;
+        int                             m_padding;
+        std::vector<Image>              m_images;   // Kept so every Build repacks all of them
+        std::map<std::string, Entry>    m_entries;
+        std::unique_ptr<Texture2DArray> m_texture;
+
+    public:
+        /** @brief Atlas with layers of the given size
+         *@param[in] padding Edge pixels repeated around every image
+         */
+        TextureAtlas(glm::ivec2 layerSize = {2048, 2048}, int padding = 2);
+
+        /** @brief Adds an image file, packed by the next Build. An image of the same name is replaced
+         *@return False if the image can't be read or doesn't fit a layer
+         */
+        bool Add(const std::string& name, const std::string& image, bool flip);
+        bool Add(const std::string& name, const unsigned char* pixels, glm::ivec2 size); // RGBA8, rows bottom up
+
+        /** @brief Packs every added image and uploads the layers, replacing an earlier build. Needs the context
+         *@param[in] filter GL_LINEAR or GL_NEAREST
+         */
+        void Build(GLenum filter, bool mipmaps = true);
+
+        const Entry* Get(const std::string& name) const; // nullptr if not in the last build
+        Texture2DArray* GetTexture();
+        size_t Size() const;
+    };
+
+    // Offline conversion of images to KTX2 files holding their whole mip chain, so loading never has to
+    // generate mipmaps. Levels are filtered in linear light for sRGB images and optionally block compressed.
+    // Files cook in parallel over the job system, as do the rows of each level and the blocks of every level.
+    class TextureCooker{
+    public:
+        enum class Filter{ Box, Kaiser };
+        enum class Encoding{ RGBA8, BC1, BC3, BC7 };
+
+        struct Settings{
+            Filter      filter{Filter::Kaiser};
+            Encoding    encoding{Encoding::BC3};    // Read by every S3TC context, BC7 is decoded on the CPU without BPTC
+            bool        srgb{true};     // Color data, alpha and non color textures should turn it off
+            bool        flip{false};
+        };
+
+    private:
+        JobSystem*  m_jobs;
+
+    public:
+        TextureCooker(JobSystem& jobs = JobSystem::Default());
+
+        /** @brief Mip chain of an RGBA8 image, the first level being the image itself */
+        std::vector<std::vector<unsigned char>> GenerateMips(const unsigned char* pixels, glm::ivec2 size, Filter filter, bool srgb);
+
+        /** @brief Encodes every level of an RGBA8 mip chain into the blocks of the encoding */
+        Texture2D::Compressed Encode(const std::vector<std::vector<unsigned char>>& levels, glm::ivec2 size, Encoding encoding, bool srgb);
+
+        /** @brief Cooks one image file into a KTX2 file
+         *@return False if the image couldn't be read or the output written
+         */
+        bool Cook(const std::string& image, const std::string& output, const Settings& settings);
+
+        /** @brief Cooks pairs of image and output paths in parallel
+         *@return Number of files cooked
+         */
+        size_t Cook(const std::vector<std::pair<std::string, std::string>>& files, const Settings& settings);
+    };
+
+    // Keeps only the mip levels textures need on screen in video memory. Textures start with their smallest
+    // levels, Require reports how large one is drawn and Update streams finer levels in from the copy kept in
+    // memory. Past the budget, the finest levels of the least recently needed textures are dropped first.
+    class TextureStreamer{
+    private:
+        struct Entry{
+            std::shared_ptr<Texture2D>  texture;
+            std::string                 image;
+            std::atomic<int>            state{0};       // 0 reading, 1 read, -1 failed
+            Texture2D::Compressed       chain;          // Every level, the GPU holds those from resident on
+            int                         resident{-1};   // Finest level uploaded, -1 before the first upload
+            int                         wanted{};       // Finest level needed, the last one when not drawn
+            float                       pixels{};       // Largest on screen size required since the last Update
+            unsigned long long          lastUsed{};     // Update count when last required
+        };
+
+        JobSystem*                              m_jobs;
+        size_t                                  m_budget;
+        size_t                                  m_frameBudget;
+        int                                     m_initialSize{64};
+        unsigned long long                      m_frame{};
+        size_t                                  m_residentBytes{};
+        std::vector<std::shared_ptr<Entry>>     m_entries;
+        std::map<const Texture2D*, Entry*>      m_index;
+
+        void SetResident(Entry& entry, int level);
+        bool MakeRoom(size_t bytes, const Entry* keep); // Evicts levels until bytes more fit the budget
+
+    public:
+        /** @brief TextureStreamer Constructor
+         *@param[in] jobs System reading the images, the default system when null
+         *@param[in] budget Bytes of mip levels kept on the GPU
+         *@param[in] frameBudget Bytes uploaded per Update, one texture gaining levels may go over it
+         */
+        TextureStreamer(JobSystem* jobs = nullptr, size_t budget = 256 << 20, size_t frameBudget = 4 << 20);
+
+        /** @brief Starts reading an image, needs the context. DDS and KTX2 files bring their mip chain,
+         * other images are decoded to RGBA and get one generated on the job
+         *@param[in] filter GL_LINEAR or GL_NEAREST, sampled mipmapped
+         *@param[in] srgb If a generated chain is filtered in linear light and sampled as sRGB
+         *@return Texture showing a placeholder pixel until its smallest levels are uploaded. Its name
+         * changes whenever levels are streamed in or dropped, so it shouldn't be kept
+         */
+        std::shared_ptr<Texture2D> Load(std::string image, bool flip, GLenum filter, bool srgb = false);
+
+        /** @brief Notes the texture is drawn this frame about pixels wide, textures not streamed are ignored */
+        void Require(const Texture2D* texture, float pixels);
+
+        /** @brief Uploads read images and moves residency towards the required levels, call once a frame on
+         * the context thread. Textures only the streamer still holds are dropped
+         */
+        void Update();
+
+        /** @brief Drops every texture and the copies of their levels */
+        void Release();
+
+        void SetBudget(size_t bytes);
+        void SetFrameBudget(size_t bytes);
+        void SetInitialSize(int pixels); // Largest edge of the levels uploaded first
+        void SetJobSystem(JobSystem& jobs);
+        size_t GetResidentBytes();
+        int GetResidentLevel(const Texture2D* texture); // Finest level on the GPU, -1 while loading or unknown
+        size_t Size();
+    };
+
+    // Linked program binaries kept on disk, so later runs skip compiling and linking. A binary is found by a
+    // hash of the stage sources, defines included, and the driver's vendor, renderer and version strings.
+    // Binaries the driver rejects are compiled again and replaced. Off until a directory is set.
+    class ProgramCache{
+    public:
+        // A program on its way, Link runs the steps back to back
+        struct Build{
+            GLuint                      program{};
+            std::vector<unsigned int>   shaders;    // Stages compiling, none once finished or loaded from a binary
+            std::string                 path;       // Where the binary goes, empty when it isn't stored
+        };
+
+        /** @brief Stores binaries in an existing directory, empty turns the cache off */
+        static void SetDirectory(const std::string& directory);
+        static std::string GetDirectory();
+
+        /** @brief Program of the stages, loaded from its binary when one is stored. Needs the context
+         *@param[in] stages Shader type and source of every stage
+         *@return Program name, failed compiles and links are logged
+         */
+        static GLuint Link(const std::vector<std::pair<GLenum, std::string>>& stages);
+
+        /** @brief Loads the stored binary, or issues the compiles and the link without reading any status */
+        static Build Start(const std::vector<std::pair<GLenum, std::string>>& stages);
+
+        /** @brief If Finish won't wait, always true without KHR_parallel_shader_compile as nothing can tell */
+        static bool IsDone(const Build& build);
+
+        /** @brief Waits for the link, logs failures, stores the binary and deletes the stage shaders */
+        static void Finish(Build& build);
+
+        static bool IsSupported(); // GL 4.1 or ARB_get_program_binary with a binary format, needs the context
+        static unsigned int GetHits(); // Programs loaded from binaries
+        static unsigned int GetMisses(); // Programs compiled while the cache was on
+    };
+
     class Shader
     {
+    public:
+        // Values sent by Update, copied into frame packets when rendering on another thread
+        struct Uniforms{
+            std::map<std::string, bool>         bools;
+            std::map<std::string, int>          ints;
+            std::map<std::string, float>        floats;
+            std::map<std::string, glm::mat4>    mat4s;
+            std::map<std::string, Texture2D*>   textures;
+            std::map<std::string, Texture2DArray*> textureArrays;
+            std::map<std::string, SamplerState> samplers;   // Override the sampler of the texture of the same name
+        };
+
+        // GL names of a bound texture, taken with the uniforms so another thread binds them without the texture
+        struct TextureBinding{
+            GLenum          target;
+            unsigned int    texture;
+            unsigned int    sampler;
+        };
+
     private:
+        friend class ShaderBatch;
+
         unsigned int m_ID;
 
-        std::map<std::string, bool>         m_bools;
-        std::map<std::string, int>          m_ints;
-        std::map<std::string, float>        m_floats;
-        std::map<std::string, glm::mat4>    m_mat4s;
-        std::map<std::string, Texture2D*>   m_textures;
+        Uniforms                            m_uniforms;
+        bool                                m_transparent{false};
+
+        Shader() = default; // The batch sets the program
 
     public:
         Shader(std::string vertexPath, std::string fragmentPath);
@@ -74,32 +685,219 @@ namespace glWrap
         void Use();
         void Update();
 
+        /** @brief Sends a snapshot of the uniforms instead of the current values
+         *@param[in] uniforms Values taken with GetUniforms, possibly on another thread
+         */
+        void Update(const Uniforms& uniforms);
+
+        /** @brief Sends uniforms to a program without reading any Shader, for frames rendered on another thread
+         *@param[in] program Program the uniforms were taken from, it has to be current
+         *@param[in] bindings Texture names from GetBindings, null to read the textures themselves
+         */
+        static void Update(unsigned int program, const Uniforms& uniforms, const TextureBinding* bindings = nullptr);
+
+        /** @brief Names of the textures the uniforms bind, in the order Update binds them */
+        static void GetBindings(const Uniforms& uniforms, std::vector<TextureBinding>& bindings);
+        const Uniforms& GetUniforms();
+
+        unsigned int GetID();
+
+        /** @brief Location of a uniform for CommandBuffer slots, needs the context. -1 if the program doesn't use it */
+        int GetUniformLocation(const std::string& name);
+        unsigned int GetTextureKey(); // Hash of the bound texture set, used for draw sorting
+        bool IsTransparent();
+
+        /** @brief Draws users of this shader blended, back to front, after all opaque draws
+         *@param[in] isTrue If the shader outputs transparent fragments
+         */
+        void SetTransparent(bool isTrue);
+
         void SetBool(const std::string name, bool value);
         void SetInt(const std::string name, int value);
         void SetFloat(const std::string name, float value);
         void SetMatrix4(const std::string name, glm::mat4 mat);
-        void SetTexture(const std::string name, Texture2D* texture);
+        void SetTexture(const std::string name, Texture2D* texture); // Null removes the texture
+        void SetTextureArray(const std::string name, Texture2DArray* texture);
+
+        /** @brief Samples the texture or texture array bound to name with this state instead of its own */
+        void SetSampler(const std::string name, const SamplerState& sampler);
+    };
+    // Builds many shaders without waiting on each. Add issues the compiles and the link and no status is read
+    // until a program is finished, so drivers compiling on their own threads work on the whole batch at once.
+    // With KHR_parallel_shader_compile, IsReady polls completion so loading can go on meanwhile.
+    class ShaderBatch{
+    private:
+        struct Pending{
+            std::shared_ptr<Shader>     shader;
+            ProgramCache::Build         build;
+        };
+
+        std::vector<Pending> m_pending;
+
+        std::shared_ptr<Shader> Add(const std::vector<std::pair<GLenum, std::string>>& stages);
+
+    public:
+        /** @brief Starts building a shader, same parameters as Shader. Needs the context
+         *@return Shader usable at once, its first use waits for the build if IsReady hasn't returned true
+         */
+        std::shared_ptr<Shader> Add(std::string vertexPath, std::string fragmentPath);
+        std::shared_ptr<Shader> Add(const char* vertexShader, const char* fragmentShader, bool isText);
+
+        /** @brief Finishes the shaders the driver is done with. Without KHR_parallel_shader_compile that can't
+         * be polled, every shader is finished and the call waits for all of them
+         *@return True when no shader is left building
+         */
+        bool IsReady();
+        void Wait(); // Finishes every shader
+        size_t GetPending();
+
+        /** @brief If the driver reports compile completion, needs the context */
+        static bool IsParallel();
+
+        /** @brief Threads the driver may compile on, ignored without the extension. Needs the context */
+        static void SetCompilerThreads(unsigned int count);
+
+        ShaderBatch() = default;
+        ShaderBatch(const ShaderBatch&) = delete;
+        ShaderBatch& operator=(const ShaderBatch&) = delete;
+        ~ShaderBatch(); // Waits for what is left, needs the context
     };
 
+    // Feature combinations of one vertex and fragment source pair, compiled on demand. Sources declare their
+    // keywords with "#pragma keywords NAME ...", each keyword is one bit of a variant key and the set ones are
+    // defined to 1 after the #version line. Every variant is its own Shader with its own uniform values.
+    class ShaderVariants{
+    private:
+        std::string                                 m_vertex, m_fragment;
+        std::vector<std::string>                    m_keywords;     // Bit i of a key is keyword i
+        std::map<uint64_t, std::shared_ptr<Shader>> m_variants;
+
+        void ReadKeywords(const std::string& source);
+
+    public:
+        /** @brief Reads the sources and their keywords, needs the context when precompiling
+         *@param[in] precompile Keyword sets compiled now instead of on first use
+         */
+        ShaderVariants(std::string vertexPath, std::string fragmentPath, const std::vector<std::vector<std::string>>& precompile = {});
+        ShaderVariants(const char* vertexShader, const char* fragmentShader, bool isText, const std::vector<std::vector<std::string>>& precompile = {});
+
+        /** @brief Key of a keyword set, unknown keywords are logged and left out */
+        uint64_t GetKey(const std::vector<std::string>& keywords);
+
+        /** @brief Variant of the key, compiled on first use. Needs the context
+         *@return Shader owned by the set, valid as long as it
+         */
+        Shader* Get(uint64_t key);
+        Shader* Get(const std::vector<std::string>& keywords);
+
+        void Precompile(const std::vector<uint64_t>& keys); // Compiled as one ShaderBatch, needs the context
+        const std::vector<std::string>& GetKeywords();
+        size_t Size(); // Variants compiled
+    };
+
+    // Orientation is kept as a quaternion, the Euler degrees in m_transform.rot are applied
+    // X, then Y, then Z in local space and kept in sync. The basis vectors keep their Euler meaning:
+    // Z yaws and Y pitches a forward vector that starts along +X.
     class WorldObject{
+    protected:
+        unsigned int m_version{}; // Bumped by every setter, lets dependent data notice changes
+        unsigned int m_matrixVersion{~0u};
+        unsigned int m_basisVersion{~0u};
+        glm::quat    m_orientation{1.0f, 0.0f, 0.0f, 0.0f};
+        glm::mat4    m_matrix{1.0f};
+        glm::vec3    m_forward{},
+                     m_right{},
+                     m_up{};
+
+        void UpdateBasis();
+
     public:
         Transform   m_transform{ {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}, {1.f, 1.f, 1.f} };
 
+        unsigned int GetVersion();
+
         glm::vec3 GetForwardVector();
         glm::vec3 GetUpwardVector();
         glm::vec3 GetRightVector();
+        glm::quat GetOrientation();
+
+        /** @brief Model matrix, recomputed only after a setter changed the transform */
         glm::mat4 GetTransformMatrix();
 
+        /** @brief Recomputes the stale matrices of many objects at once with TransformBatch::Compose
+         *@param[in] objects Objects to update
+         *@param[in] count Number of objects
+         */
+        static void UpdateTransformMatrices(WorldObject* const* objects, size_t count);
+
         void SetTransform(Transform transform);
         void SetPosition(glm::vec3 position);
         void SetRotation(glm::vec3 rotation);
+        void SetOrientation(glm::quat orientation);
         void SetScale(glm::vec3 scale);
 
         void AddPosition(glm::vec3 position);
         void AddRotation(glm::vec3 rotation);
         void AddScale(glm::vec3 scale);
+
+        /** @brief Turns around an axis of the object's own space, e.g. {1, 0, 0} to pitch
+         *@param[in] degrees Angle, counter clockwise looking down the axis
+         *@param[in] axis Rotation axis, normalized
+         */
+        void Rotate(float degrees, glm::vec3 axis);
+
+        /** @brief Turns around a world space axis, e.g. {0, 1, 0} to yaw without rolling
+         *@param[in] degrees Angle, counter clockwise looking down the axis
+         *@param[in] axis Rotation axis, normalized
+         */
+        void RotateWorld(float degrees, glm::vec3 axis);
+    };
+
+    // Transforms of many objects stored component by component and composed into model matrices
+    // with SIMD, 4 or 8 at a time. Update only recomputes blocks holding changed transforms.
+    class TransformBatch{
+    public:
+        static const unsigned int blockSize = 8;
+
+    private:
+        std::vector<float>          m_components[9];    // Position, rotation in degrees and scale, x y z each
+        std::vector<glm::mat4>      m_matrices;
+        std::vector<unsigned char>  m_dirty;            // Per block
+        size_t                      m_size{};
+
+        void UpdateBlocks(size_t begin, size_t end);
+
+    public:
+        /** @brief Appends a transform
+         *@return Index of the transform
+         */
+        unsigned int Add(const Transform& transform);
+        void Set(unsigned int index, const Transform& transform);
+        void SetPosition(unsigned int index, glm::vec3 position);
+        void SetRotation(unsigned int index, glm::vec3 rotation);
+        void SetScale(unsigned int index, glm::vec3 scale);
+        Transform Get(unsigned int index);
+        size_t Size();
+        void Clear();
+
+        /** @brief Recomputes the matrices of blocks changed since the last Update */
+        void Update();
+
+        /** @brief Update with the blocks split over the jobs of a system */
+        void Update(JobSystem& jobs);
+        const glm::mat4& GetMatrix(unsigned int index);
+        const std::vector<glm::mat4>& GetMatrices(); // Padded to whole blocks
+
+        /** @brief Composes model matrices matching WorldObject::GetTransformMatrix
+         *@param[in] transforms Transforms to compose
+         *@param[out] matrices Receives count matrices
+         *@param[in] count Number of transforms
+         */
+        static void Compose(const Transform* transforms, glm::mat4* matrices, size_t count);
     };
 
+    // View, projection and their product are cached and only rebuilt after the transform, target,
+    // lens settings or aspect changed
     class Camera : public WorldObject{
     private:
         float       m_FOV{90};
@@ -107,10 +905,33 @@ namespace glWrap
         bool        m_perspective{true};
         glm::vec3*   m_target{};
 
+        glm::mat4       m_view{1.0f};
+        glm::mat4       m_projection{1.0f};
+        glm::mat4       m_viewProjection{1.0f};
+        Frustum         m_frustum;
+        unsigned int    m_viewVersion{~0u};
+        glm::vec3       m_viewTarget{};     // Target position the view was built for
+        glm::vec2       m_aspect{};         // Aspect the projection was built for
+        bool            m_projectionDirty{true};
+        bool            m_viewProjectionDirty{true};
+
+        void UpdateView();
+        void UpdateProjection(glm::vec2 aspect);
+        void UpdateViewProjection(glm::vec2 aspect);
+
     public:
         float GetFOV();
+        glm::vec2 GetClip();
         glm::mat4 GetView();
         glm::mat4 GetProjection(glm::vec2 aspect);
+
+        /** @brief Projection * view
+         *@param[in] aspect Viewport size, usually Window::GetSize
+         */
+        const glm::mat4& GetViewProjection(glm::vec2 aspect);
+
+        /** @brief Clip planes of GetViewProjection */
+        const Frustum& GetFrustum(glm::vec2 aspect);
         bool IsPerspective();
 
         void SetTarget(glm::vec3* target);
@@ -130,31 +951,440 @@ namespace glWrap
                                     m_VAO,
                                     m_EBO;
 
+        GLuint                      m_instanceBuffer{};     // Instance range the VAO currently points at
+        size_t                      m_instanceOffset{~(size_t)0};
+
+        GLint                       m_baseVertex{-1};       // Location in the GeometryPool, -1 if not pooled
+        GLuint                      m_firstIndex{};
+
+        AABB                        m_bounds;
+
         Primitive() = default;
         void Draw();
+        void ComputeBounds();
+
+        /** @brief Draws the primitive once per transform in the instance buffer
+         *@param[in] instanceBuffer Buffer of per-instance glm::mat4 transforms
+         *@param[in] first Index of the first transform to use
+         *@param[in] count Amount of instances to draw
+         */
+        void DrawInstanced(GLuint instanceBuffer, unsigned int first, unsigned int count);
     };
 
     class Mesh{
         public:
         std::vector<Primitive> m_primitives;
+        AABB                   m_bounds;
 
         Mesh() = default;
+        void ComputeBounds(); // Recomputes primitive bounds and their union
+    };
+
+    // Layout of one glMultiDrawElementsIndirect record
+    struct DrawCommand{
+        GLuint  count;
+        GLuint  instanceCount;
+        GLuint  firstIndex;
+        GLint   baseVertex;
+        GLuint  baseInstance;
+    };
+
+    // Vertices and indices of many primitives in one VAO, so they can share a multi-draw call
+    class GeometryPool{
+    private:
+        std::vector<Vertex>         m_vertices;
+        std::vector<unsigned short> m_indices;
+        GLuint                      m_VAO{},
+                                    m_VBO{},
+                                    m_EBO{},
+                                    m_instanceBuffer{};
+        bool                        m_dirty{false};
+
+    public:
+        /** @brief Appends the primitive's data and stores its offsets in the primitive
+         *@param[in] primitive Primitive with filled vertices and indices
+         */
+        void Add(Primitive& primitive);
+
+        /** @brief Binds the pool VAO, uploading data added since the last bind
+         *@param[in] instanceBuffer Buffer of per-instance transforms, addressed by baseInstance
+         */
+        void Bind(GLuint instanceBuffer);
+        void Release();
     };
 
     class Instance : public WorldObject {
     private:
-        Mesh*                   m_mesh;
+        Mesh*                   m_mesh{nullptr};
+        Mesh*                   m_occluder{nullptr};
         std::vector<Shader*>    m_shaders;
         bool                    m_visible{true};
+        AABB                    m_worldBounds;
+        unsigned int            m_boundsVersion{~0u};
 
     public:
         void SetMesh(Mesh* mesh);
         void SetShader(Shader* shader, int primitive);
         void SetVisibility(bool visibility);
 
+        /** @brief Marks the instance as an occluder, rasterized into the OcclusionBuffer every frame
+         *@param[in] mesh Usually a simplified, fully enclosed proxy of the drawn mesh, nullptr to stop occluding
+         */
+        void SetOccluder(Mesh* mesh);
+
         Mesh* GetMesh();
+        Mesh* GetOccluder();
         Shader* GetShader(int primitive);
         bool GetVisibility();
+
+        /** @brief Mesh bounds in world space, recomputed only after the transform changed */
+        const AABB& GetWorldBounds();
+    };
+
+    // Instances kept in a bounding volume hierarchy, for culling and ray queries that
+    // visit a logarithmic share of the scene. Static instances are placed by a SAH build,
+    // dynamic ones are checked for transform changes and refit in place.
+    class Scene{
+    private:
+        struct Node{
+            AABB            bounds;
+            unsigned int    first;  // Range of m_order covered by the node
+            unsigned int    count;
+            unsigned int    left;   // Index of the left child, the right one follows it. 0 for leaves
+            unsigned int    parent;
+        };
+
+        std::vector<Instance*>      m_instances;
+        std::vector<bool>           m_static;
+        std::vector<Instance*>      m_unbounded;    // Instances without mesh bounds, never culled
+        std::vector<Node>           m_nodes;
+        std::vector<unsigned int>   m_order;        // Instance indices in leaf order
+        std::vector<unsigned int>   m_leafOf;       // Leaf node of every instance
+        std::vector<unsigned int>   m_versions;     // Transform version the tree was fitted to
+        std::vector<AABB>           m_bounds;
+        std::vector<glm::vec3>      m_centroids;
+        float                       m_builtCost{};
+        unsigned int                m_refits{};
+        unsigned int                m_generation{};
+        bool                        m_dirty{false};
+
+        void Build();
+        void BuildNode(unsigned int node, unsigned int first, unsigned int count, unsigned int parent);
+        float GetCost();
+
+    public:
+        /** @brief Adds an instance, the tree is rebuilt at the next Update
+         *@param[in] instance Instance to add, must outlive its membership
+         *@param[in] isStatic If the instance never moves, static instances are not checked for changes
+         */
+        void Add(Instance* instance, bool isStatic = true);
+        void Remove(Instance* instance);
+        size_t Size();
+
+        /** @brief Incremented by every Add and Remove, lets data mirrored elsewhere know when to rebuild */
+        unsigned int GetGeneration();
+        const std::vector<Instance*>& GetInstances();
+        bool IsStatic(size_t index);
+
+        /** @brief Rebuilds after membership changes, otherwise refits nodes of moved dynamic instances.
+         * Refitting falls back to a rebuild when it made the tree much worse than a fresh build.
+         */
+        void Update();
+
+        /** @brief Appends visible instances intersecting the frustum
+         *@param[in] frustum Frustum to test against
+         *@param[out] visible Receives the instances
+         */
+        void Cull(const Frustum& frustum, std::vector<Instance*>& visible);
+
+        /** @brief Closest instance triangle hit by a ray
+         *@param[in] origin Ray origin in world space
+         *@param[in] direction Ray direction in world space
+         *@param[out] distance Distance along the direction to the hit, if not null
+         *@return Hit instance or nullptr
+         */
+        Instance* Raycast(glm::vec3 origin, glm::vec3 direction, float* distance = nullptr);
+    };
+
+    // Low resolution depth buffer rasterized on the CPU from occluder meshes, with a per tile
+    // farthest depth for quick rejection. Boxes whose screen rectangle lies behind the stored
+    // depth can be skipped before submission. Runs without a GL context.
+    class OcclusionBuffer{
+    public:
+        static const int tileWidth = 32;
+        static const int tileHeight = 16;
+
+    private:
+        struct ScreenTriangle{
+            glm::vec3 v[3]; // Pixel x, y and depth in [0, 1]
+        };
+
+        glm::ivec2                              m_size;
+        glm::ivec2                              m_tiles;
+        JobSystem*                              m_jobs;
+        glm::mat4                               m_viewProjection{1.0f};
+        std::vector<float>                      m_depth;
+        std::vector<float>                      m_tileMax;
+        std::vector<ScreenTriangle>             m_triangles;
+        std::vector<std::vector<unsigned int>>  m_bins;     // Triangles overlapping every tile
+        double                                  m_rasterTime{};
+
+        void AddTriangle(glm::vec4 a, glm::vec4 b, glm::vec4 c);
+        void RasterizeTile(unsigned int tile);
+
+    public:
+        /** @brief OcclusionBuffer Constructor
+         *@param[in] size Resolution, rounded up to whole tiles
+         *@param[in] jobs System the tiles are rasterized on, the default system when null
+         */
+        OcclusionBuffer(glm::ivec2 size = {256, 128}, JobSystem* jobs = nullptr);
+
+        /** @brief Starts a frame, clearing depth and the occluder list */
+        void Clear(const glm::mat4& viewProjection);
+
+        /** @brief Transforms and bins the triangles of a mesh
+         *@param[in] mesh Occluder mesh, only primitive vertices and indices are read
+         *@param[in] transform Model matrix of the occluder
+         */
+        void AddOccluder(const Mesh& mesh, const glm::mat4& transform);
+
+        /** @brief Rasterizes every binned triangle, tiles are spread over the jobs */
+        void Rasterize();
+
+        /** @brief If any part of the box could be in front of the rasterized occluders */
+        bool IsVisible(const AABB& box) const;
+
+        double GetRasterTime(); // Milliseconds spent in the last Rasterize
+        glm::ivec2 GetSize();
+        const std::vector<float>& GetDepth();
+    };
+
+    // What rendering reads of a queued instance, copied so the caller can change the instance meanwhile
+    struct FrameDraw{
+        glm::mat4       matrix;
+        AABB            bounds;
+        Mesh*           mesh;
+        Mesh*           occluder;
+        unsigned int    shaders;    // Index into FramePacket::drawShaders of its first primitive's shader
+    };
+
+    // What rendering reads of a shader, taken once per frame however many draws use it
+    struct FrameShader{
+        Shader*                             shader;
+        unsigned int                        program;
+        unsigned int                        textureKey;
+        bool                                transparent;
+        Shader::Uniforms                    uniforms;   // Copied only for the render thread
+        std::vector<Shader::TextureBinding> bindings;
+    };
+
+    // Queued primitive draw, executed in the order of its packed sort key
+    struct DrawItem{
+        uint64_t            key;
+        const FrameShader*  shader;
+        Primitive*          primitive;
+        unsigned int        transform;  // Index into the frame's model matrices
+    };
+
+    // Instances sharing a primitive and shader, drawn with a single instanced call
+    struct InstanceBatch{
+        const FrameShader*  shader;
+        Primitive*          primitive;
+        unsigned int        first;  // Offset into the frame's instance transforms
+        unsigned int        count;
+    };
+
+    // Draw list recorded without GL, so any thread can fill one. Window::Submit takes the commands,
+    // they are replayed on the context thread after the queued instances, in submission order
+    // unless SetOrder says otherwise. Recorded objects must stay alive until the frame was drawn.
+    class CommandBuffer{
+    public:
+        enum class Op : unsigned char{ UseShader, SetInt, SetFloat, SetVec4, SetMatrix4, BindTexture, BindTextureArray, Draw };
+
+        struct Command{
+            Op              op;
+            int             slot;       // Uniform location or texture unit
+            void*           object;     // Shader, Texture2D, Texture2DArray or Primitive
+            unsigned int    first;      // Offset into the values or transforms
+            unsigned int    count;
+        };
+
+    private:
+        std::vector<Command>    m_commands;
+        std::vector<float>      m_values;       // Uniform data, ints keep their bits
+        std::vector<glm::mat4>  m_transforms;   // Model matrices of the draws
+        int                     m_order{};
+
+    public:
+        /** @brief Makes the shader current and sends its own uniforms, like the queued draws do */
+        void UseShader(Shader* shader);
+
+        /** @brief Overrides a uniform of the current shader for the following draws
+         *@param[in] slot Location from Shader::GetUniformLocation, -1 is ignored
+         */
+        void SetInt(int slot, int value);
+        void SetFloat(int slot, float value);
+        void SetVec4(int slot, glm::vec4 value);
+        void SetMatrix4(int slot, const glm::mat4& value);
+        void BindTexture(unsigned int unit, Texture2D* texture);
+        void BindTexture(unsigned int unit, Texture2DArray* texture);
+
+        /** @brief Draws the primitive once per model matrix with the current shader
+         *@param[in] transforms Model matrices, the view projection of the frame is applied at replay
+         */
+        void Draw(Primitive* primitive, const glm::mat4* transforms, unsigned int count = 1);
+
+        /** @brief Buffers replay from the lowest order up, equal orders in submission order */
+        void SetOrder(int order);
+        int GetOrder() const;
+
+        void Clear();
+        bool IsEmpty() const;
+        size_t Size() const;    // Recorded commands
+        const std::vector<Command>& GetCommands() const;
+        const std::vector<float>& GetValues() const;
+        const std::vector<glm::mat4>& GetTransforms() const;
+    };
+
+    // Culls a Scene on the GPU with compute shaders, GL 4.3 only. Instance transforms and bounds
+    // stay resident in storage buffers, each frame a compute pass tests them against the frustum,
+    // and optionally the previous frame's Hi-Z pyramid, then appends the visible transforms and
+    // bumps the instance counts of indirect commands drawn from the GeometryPool.
+    class GpuCulling{
+    private:
+        struct Group{ // Commands drawn with one shader
+            Shader*         shader;
+            unsigned int    first;
+            unsigned int    count;
+        };
+
+        Scene*                      m_scene{nullptr};
+        unsigned int                m_generation{};
+        std::vector<unsigned int>   m_mirrored;     // Scene indices drawn here, checked for changes every frame
+        std::vector<unsigned int>   m_versions;
+        std::vector<Instance*>      m_fallback;     // Drawn through the CPU path: transparent or unpooled
+        std::vector<glm::mat4>      m_models;
+        std::vector<glm::vec4>      m_bounds;       // Center and extent per instance, extent w flags it
+        std::vector<DrawCommand>    m_commands;     // Instance counts are reset to these every frame
+        std::vector<Group>          m_groups;
+        unsigned int                m_recordCount{};
+        GLuint                      m_cullProgram{},
+                                    m_pyramidProgram{},
+                                    m_recordBuffer{},
+                                    m_boundsBuffer{},
+                                    m_modelBuffer{},
+                                    m_commandBuffer{},
+                                    m_visibleBuffer{};
+        GLuint                      m_depthSource{};
+        glm::ivec2                  m_depthSize{};
+        GLuint                      m_hiZ{};
+        int                         m_hiZLevels{};
+        bool                        m_hiZValid{false};
+        glm::mat4                   m_hiZViewProjection{1.0f};
+
+        void Build(Scene& scene, Shader* defaultShader);
+
+    public:
+        GpuCulling();
+        ~GpuCulling();
+
+        /** @brief Mirrors the scene on the GPU, rebuilt when its membership changed, otherwise
+         * only instances whose transform or visibility changed are uploaded
+         *@param[in] scene Scene to draw
+         *@param[in] defaultShader Shader of primitives without one
+         *@param[out] fallback Receives instances the GPU path can't draw, to be drawn the usual way
+         */
+        void Prepare(Scene& scene, Shader* defaultShader, std::vector<Instance*>& fallback);
+
+        /** @brief Runs the culling pass, writing the visible instances' projection * view * model and the indirect commands
+         *@param[in] frustum Planes to test against
+         *@param[in] viewProjection Camera matrix the models are combined with
+         */
+        void Dispatch(const Frustum& frustum, const glm::mat4& viewProjection);
+
+        /** @brief Submits one glMultiDrawElementsIndirect per shader
+         *@return Number of draw calls issued
+         */
+        unsigned int Draw(GeometryPool& geometry, Shader*& currentShader);
+
+        /** @brief Uses a depth texture for occlusion, its Hi-Z pyramid is built after every frame
+         * and tested against by the next one
+         *@param[in] depthTexture Depth attachment the frame is rendered into, 0 to stop
+         *@param[in] size Texture resolution
+         */
+        void SetDepthSource(GLuint depthTexture, glm::ivec2 size);
+
+        /** @brief Reduces the depth source into the Hi-Z pyramid, called by Window after drawing */
+        void BuildHiZ(const glm::mat4& viewProjection);
+        unsigned int GetRecordCount(); // Instance primitives tested per frame
+    };
+
+    // Single producer, single consumer handoff of the latest value. The producer fills its back slot
+    // and swaps it into the middle, the consumer swaps the middle out when it holds something newer.
+    // Neither side ever waits, a slow consumer just skips the values it never picked up.
+    // A consumer that would rather sleep checks IsPending under its own condition variable.
+    template <typename T>
+    class TripleBuffer{
+    private:
+        static const unsigned int fresh = 4; // Set on the middle index when it wasn't consumed yet
+
+        T                           m_slots[3];
+        std::atomic<unsigned int>   m_middle{1};
+        unsigned int                m_back{0},
+                                    m_front{2};
+
+    public:
+        T& GetBack(){ return m_slots[m_back]; }
+        T& GetFront(){ return m_slots[m_front]; }
+
+        /** @brief Hands the back slot to the consumer and takes the middle one as the new back */
+        void Publish(){ m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & 3; }
+
+        /** @brief Takes the newest published slot as the front
+         *@return False if nothing was published since the last call, the front is unchanged then
+         */
+        bool Acquire(){
+            if (!(m_middle.load(std::memory_order_acquire) & fresh)) return false;
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & 3;
+            return true;
+        }
+
+        /** @brief If a published slot wasn't acquired yet */
+        bool IsPending() const { return m_middle.load(std::memory_order_acquire) & fresh; }
+    };
+
+    // Everything needed to render one frame, owned by whoever renders it
+    struct FramePacket{
+        std::vector<FrameDraw>      draws;          // Queued instances first, then those a Scene culled
+        size_t                      queued{};       // Draws still to be frustum culled
+        std::vector<unsigned int>   drawShaders;    // Index into shaders for every primitive of the draws
+        std::vector<FrameShader>    shaders;
+        bool                        snapshot{false};    // Shaders carry their uniforms, nothing live is read
+        unsigned int                sceneCulled{};
+        Scene*                      gpuScene{nullptr};
+        std::vector<CommandBuffer>  commandBuffers;
+        glm::mat4                   viewProjection{1.0f};
+        Frustum                     frustum;
+        glm::vec3                   cameraPosition{};
+        glm::vec3                   cameraForward{};
+        float                       farClip{1.0f};
+        float                       projectionScale{1.0f};  // Pixels covered by one unit at distance one
+        bool                        perspective{true};
+        glm::ivec2                  size{};
+        glm::vec4                   color{};
+        bool                        culling{true};
+    };
+
+    // Counters of the last flushed frame
+    struct RenderStats{
+        unsigned int culled{};              // Instances rejected by the frustum test
+        unsigned int occluded{};            // Instances rejected by the occlusion buffer
+        unsigned int items{};               // Primitive draws queued
+        unsigned int drawCalls{};           // Instanced draw calls issued
+        unsigned int stateChanges{};        // Program, texture set and VAO changes after sorting
+        unsigned int stateChangesSaved{};   // Changes avoided compared to drawing in caller order
+        unsigned int glCallsIssued{};       // Binding calls that reached GL
+        unsigned int glCallsFiltered{};     // Binding calls dropped by the state cache
     };
 
     class Window{
@@ -166,7 +1396,51 @@ namespace glWrap
         GLFWwindow*                         m_window;
         std::string                         m_name;
         std::unique_ptr<Shader>             m_defaultShader;
-        Shader*                             m_currentShader;
+        Shader*                             m_currentShader{nullptr};
+        std::vector<Instance*>              m_drawQueue;
+        std::vector<Instance*>              m_culledQueue;  // Already tested against the frustum
+        std::vector<Instance*>              m_streamQueue;  // GPU culled scene instances in the frustum, for streaming
+        std::vector<WorldObject*>           m_transformQueue;
+        std::map<Shader*, unsigned int>     m_shaderSlots;  // Index of each shader in the packet being gathered
+        unsigned int                        m_sceneCulled{};
+        std::vector<DrawItem>               m_items;
+        std::vector<DrawItem>               m_sortScratch;
+        std::vector<InstanceBatch>          m_batches;
+        std::vector<glm::mat4>              m_instanceData;
+        GLuint                              m_instanceVBO{};
+        RenderStats                         m_stats{};
+        bool                                m_multiDrawSupported{false};
+        bool                                m_multiDraw{false};
+        GeometryPool                        m_geometry;
+        std::vector<DrawCommand>            m_commands;
+        GLuint                              m_indirectBuffer{};
+        bool                                m_culling{true};
+        BoxList                             m_cullBoxes;
+        std::vector<unsigned char>          m_cullResults;
+        std::unique_ptr<OcclusionBuffer>    m_occlusion;
+        bool                                m_computeSupported{false};
+        std::unique_ptr<GpuCulling>         m_gpuCulling;
+        Scene*                              m_gpuScene{nullptr};
+        std::vector<CommandBuffer>          m_commandBuffers;   // Submitted for the next frame
+        FramePacket                         m_frame;            // Reused by Flush on the calling thread
+        TripleBuffer<FramePacket>           m_packets;
+        std::thread                         m_renderThread;
+        std::atomic<bool>                   m_rendering{false};
+        std::mutex                          m_packetMutex;
+        std::condition_variable             m_packetReady;  // Signalled by Publish, the render thread sleeps on it
+        std::mutex                          m_statsMutex;
+        JobSystem*                          m_jobs;
+        GLFWwindow*                         m_uploadWindow{nullptr};    // Hidden, shares objects with m_window
+        std::thread                         m_uploadThread;
+        std::mutex                          m_uploadMutex;
+        std::condition_variable             m_uploadWake;
+        bool                                m_uploading{false};
+        std::deque<std::pair<std::function<void()>, std::function<void()>>> m_uploadQueue;
+        std::deque<std::pair<GLsync, std::function<void()>>>                m_uploadsDone;  // Waiting for their fence
+        unsigned int                        m_pendingUploads{};
+        TextureLoader                       m_textureLoader;
+        TextureCache                        m_textureCache;
+        TextureStreamer                     m_textureStreamer;
         double                              m_lastFrameTime;
         double                              m_deltaTime;
         bool                                m_firstFrame{true};
@@ -178,6 +1452,15 @@ namespace glWrap
         static glm::dvec2                   m_deltaMousePos;
         static glm::ivec2                   m_size;
 
+        void Gather(FramePacket& frame);
+        void Publish();
+        void Render(FramePacket& frame);
+        void RequireTextures(const FramePacket& frame); // Reports every streamed texture the frame draws and how large
+        unsigned int Replay(const FramePacket& frame, const std::vector<unsigned int>& bases);
+        void UploadLoop();
+        void PollUploads();
+        void RenderLoop();
+
     public:
         glm::vec4                           m_color{0.0f, 0.0f, 0.0f, 1.0f};
         Camera*                             m_ActiveCamera{nullptr};
@@ -186,9 +1469,119 @@ namespace glWrap
         Window(std::string name, glm::ivec2 size);
         // Window(std::string name, glm::ivec2 size, GLFWwindow* context);
         void Swap();
+
+        /** @brief Queues an instance, drawn at the next Flush or Swap
+         *@param[in] instance Instance to draw, must stay alive until the queue is flushed
+         */
         void Draw(Instance& instance);
+
+        /** @brief Queues the scene's instances inside the active camera's frustum
+         *@param[in] scene Scene to draw, updated before culling. While GPU culling is on the first scene
+         * of a frame is culled at Flush instead, further ones still on the CPU
+         */
+        void Draw(Scene& scene);
+
+        /** @brief Sorts the queued instances by shader, textures, mesh and depth and draws them,
+         * one instanced call per primitive and shader. Does nothing on a render thread, Swap hands the frame over
+         */
+        void Flush();
+        RenderStats GetRenderStats();
+
+        /** @brief Takes the recorded commands for the next Flush or Swap, the buffer is left empty
+         *@param[in] buffer Buffer filled on any thread, submitted from the thread calling Swap
+         */
+        void Submit(CommandBuffer& buffer);
+
+        /** @brief Moves the context to a render thread. Swap then copies the queued instances' matrices, bounds
+         * and meshes, the camera and the shaders' uniforms and texture names into a frame packet and returns at
+         * once, while the previous frame is still being drawn. Meshes and their primitives are read in place.
+         * GL resources can't be created and culling settings can't change while it runs, stop it first.
+         * Uploads publish and the texture loader and streamer advance on the thread calling Swap, which has
+         * no context then. So the render thread refuses to start while the upload thread runs or uploads or
+         * texture loads are pending, and Upload and SetUploadThread refuse while it runs. Textures released
+         * to the TextureCache are still deleted, by the render thread
+         *@param[in] isTrue If frames should be rendered on their own thread
+         */
+        void SetRenderThread(bool isTrue);
+        bool IsRenderThreaded();
+
+        /** @brief Draws every shader's batches with one glMultiDrawElementsIndirect call,
+         * only has an effect on GL 4.3 contexts and for meshes loaded while enabled
+         *@param[in] isTrue If multi-draw should be used, enabled by default when supported
+         */
+        void SetMultiDraw(bool isTrue);
+        bool IsMultiDrawSupported();
+
+        /** @brief Skips queued instances outside the active camera's frustum, enabled by default */
+        void SetCulling(bool isTrue);
+
+        /** @brief Rasterizes the queued occluder instances on the CPU each frame and skips
+         * instances hidden behind them, see Instance::SetOccluder
+         *@param[in] isTrue If occlusion culling should run
+         */
+        void SetOcclusionCulling(bool isTrue);
+        OcclusionBuffer* GetOcclusionBuffer(); // nullptr while occlusion culling is off
+
+        /** @brief Culls drawn scenes with compute shaders instead of on the CPU, needs GL 4.3 and multi-draw.
+         * Only one scene per frame is drawn this way, see GpuCulling
+         *@param[in] isTrue If GPU culling should be used
+         */
+        void SetGpuCulling(bool isTrue);
+        bool IsGpuCullingSupported();
+        GpuCulling* GetGpuCulling(); // nullptr while GPU culling is off
+
+        /** @brief System culling, transforms and imports are split over, JobSystem::Default until set */
+        void SetJobSystem(JobSystem& jobs);
+        JobSystem& GetJobSystem();
         float GetDeltaTime();
         void LoadFile(std::map<std::string, Mesh>& container, std::string file);
+
+        /** @brief Imports the files in parallel, then creates the GL objects in file order */
+        void LoadFiles(std::map<std::string, Mesh>& container, const std::vector<std::string>& files);
+
+        /** @brief Creates a hidden context sharing objects with the window and a loader thread using it.
+         * Uploads queued with Upload then run there, so the frames drawn meanwhile aren't stalled.
+         * Refused while rendering on the render thread
+         *@param[in] isTrue If uploads should run on the loader thread
+         */
+        void SetUploadThread(bool isTrue);
+        bool IsUploadThreaded();
+
+        /** @brief Runs work on the loader thread, then publish on this thread during the Swap after the GPU
+         * signalled the fence placed behind it. Both run at once on this thread without a loader thread.
+         * Dropped while rendering on the render thread, this thread has no context to publish with
+         *@param[in] work Creates and fills GL objects, vertex arrays can't be made here as contexts don't share them
+         *@param[in] publish Hands the finished objects to their users, called in queue order
+         */
+        void Upload(std::function<void()> work, std::function<void()> publish);
+        unsigned int GetPendingUploads(); // Queued uploads not yet published
+
+        /** @brief LoadFile through Upload, the meshes appear in the container once their buffers are ready.
+         * They aren't added to the multi-draw pool, that would upload the whole pool again
+         *@param[in] container Receives the meshes, must stay alive until they are published
+         */
+        void LoadFileAsync(std::map<std::string, Mesh>& container, std::string file);
+
+        /** @brief Loader of the textures streamed in by Swap, decoded on the window's job system */
+        TextureLoader& GetTextureLoader();
+
+        /** @brief Cache whose released textures are deleted by Swap, or by the render thread while it runs */
+        TextureCache& GetTextureCache();
+
+        /** @brief Streamer updated by Swap, the textures of rendered instances are required by their projected size.
+         * Rendering on the render thread doesn't require them
+         */
+        TextureStreamer& GetTextureStreamer();
+
+        /** @brief Loads a Texture2D through Upload
+         *@param[out] texture Set once the texture is ready, must stay alive until then
+         */
+        void LoadTextureAsync(std::unique_ptr<Texture2D>& texture, std::string image, bool flip, GLenum filter, GLenum desiredChannels);
+
+        /** @brief Reads the meshes of a glTF file without touching GL, one job per primitive
+         *@return Mesh names from the file with CPU side meshes, empty if it failed to load
+         */
+        static std::vector<std::pair<std::string, Mesh>> ImportFile(const std::string& file, JobSystem& jobs);
         ~Window();
 
         bool IsKeyPressed(unsigned int key);
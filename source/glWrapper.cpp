@@ -1,5 +1,13 @@
 #include "glWrapper.hpp"
 
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define GW_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define GW_SIMD_SSE
+#endif
+
 #define GW_DEBUG
 
 #ifdef GW_DEBUG
@@ -24,14 +32,15 @@ void glWrap::Terminate(){ glfwTerminate(); }
 
 const char *defaultVertexShader = "#version 330 core\n"
 "layout (location = 0) in vec3 aPos;\n"
-"uniform mat4 model;\n"
-"uniform mat4 view;\n"
-"uniform mat4 projection;\n"
+"layout (location = 3) in mat4 iModelViewProjection;\n"
 "void main()\n"
 "{\n"
-"    gl_Position = projection * view * model * vec4(aPos, 1);\n"
+"    gl_Position = iModelViewProjection * vec4(aPos, 1);\n"
 "}\n";
 
+// First of the four attribute locations holding the per-instance projection * view * model matrix
+const GLuint instanceAttribute = 3;
+
 const char *defaultFragmentShader = "#version 330 core\n"
 "out vec4 FragColor;\n"
 "void main()\n"
@@ -39,6 +48,119 @@ const char *defaultFragmentShader = "#version 330 core\n"
 "    FragColor = vec4(0.8, 0.8, 0.8, 1);\n"
 "}\n";
 
+// 
+// *GL 4.x entry points
+// 
+// glad is generated for 3.3 core, newer functions are loaded by hand when the context has them
+
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_SRGB8_ETC2 0x9275
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC 0x9279
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXSTORAGE3DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+static PFNGLMULTIDRAWELEMENTSINDIRECTPROC glMultiDrawElementsIndirect{};
+static PFNGLDISPATCHCOMPUTEPROC glDispatchCompute{};
+static PFNGLMEMORYBARRIERPROC glMemoryBarrier{};
+static PFNGLBINDIMAGETEXTUREPROC glBindImageTexture{};
+static PFNGLTEXSTORAGE2DPROC glTexStorage2D{};
+static PFNGLTEXSTORAGE3DPROC glTexStorage3D{};
+static PFNGLGETPROGRAMBINARYPROC glGetProgramBinary{};
+static PFNGLPROGRAMBINARYPROC glProgramBinary{};
+static PFNGLPROGRAMPARAMETERIPROC glProgramParameteri{};
+static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR{};
+
+static bool compressionS3TC{}, compressionBPTC{}, compressionETC2{}; // RGTC is core since 3.0
+static float maxAnisotropy{1.0f};
+
+static bool HasVersion(int major, int minor){
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+static bool HasExtension(const char* name){
+    int count{};
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (int i{}; i < count; ++i){
+        if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) return true;
+    }
+
+    return false;
+}
+
+static void LoadEntryPoints(){
+    if (HasVersion(4, 3) || HasExtension("GL_ARB_multi_draw_indirect")){
+        glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)glfwGetProcAddress("glMultiDrawElementsIndirect");
+    }
+
+    if (HasVersion(4, 3)){ // Compute shaders, storage buffers and image load/store
+        glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)glfwGetProcAddress("glDispatchCompute");
+        glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)glfwGetProcAddress("glMemoryBarrier");
+        glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC)glfwGetProcAddress("glBindImageTexture");
+    }
+
+    if (HasVersion(4, 2) || HasExtension("GL_ARB_texture_storage")){
+        glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)glfwGetProcAddress("glTexStorage2D");
+        glTexStorage3D = (PFNGLTEXSTORAGE3DPROC)glfwGetProcAddress("glTexStorage3D");
+    }
+
+    if (HasVersion(4, 1) || HasExtension("GL_ARB_get_program_binary")){
+        glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+        glProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+        glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+    }
+
+    // The ARB version has the same completion query, only the thread count function is named differently
+    if (HasExtension("GL_KHR_parallel_shader_compile")){
+        glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    }
+    else if (HasExtension("GL_ARB_parallel_shader_compile")){
+        glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+    }
+
+    if (HasVersion(4, 6) || HasExtension("GL_ARB_texture_filter_anisotropic") || HasExtension("GL_EXT_texture_filter_anisotropic")){
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+    }
+
+    compressionS3TC = HasExtension("GL_EXT_texture_compression_s3tc");
+    compressionBPTC = HasVersion(4, 2) || HasExtension("GL_ARB_texture_compression_bptc");
+    compressionETC2 = HasVersion(4, 3) || HasExtension("GL_ARB_ES3_compatibility");
+}
+
 // 
 // *Classless
 // 
@@ -72,16 +194,7 @@ static void CreateShader(unsigned int &id, GLenum type, std::string code){
 
     glShaderSource(id, 1, &source, NULL);
 
-    glCompileShader(id);
-
-    int success; // Error handle type
-    char log[512]; // Error message
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
-    if(!success)
-    {
-        glGetShaderInfoLog(id, 512, NULL, log);
-        DEV_LOG("Failed compile: ", log);
-    }
+    glCompileShader(id); // The status is read after linking, reading it now would wait for the compile
 
     return;
 }
@@ -130,41 +243,60 @@ std::vector<unsigned short> GetIndexData(tinygltf::Model& model, tinygltf::Primi
     return indices;
 }
 
-void CreateGlObjects(glWrap::Primitive &primitive){
+static void SetVertexAttributes(){ // Layout of glWrap::Vertex for the bound VAO and GL_ARRAY_BUFFER
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+}
+
+static void SetInstanceAttributes(size_t offset){ // Per-instance mat4 for the bound VAO and GL_ARRAY_BUFFER
+    for (GLuint column{}; column < 4; ++column){ // A mat4 attribute takes four vec4 locations
+        glVertexAttribPointer(instanceAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(instanceAttribute + column, 1);
+        glEnableVertexAttribArray(instanceAttribute + column);
+    }
+}
+
+static void CreateBuffers(glWrap::Primitive &primitive){ // Buffers are shared between contexts, unlike the VAO
 
-    // DEV_LOG("Starting", "");
-    glGenVertexArrays(1, &primitive.m_VAO);
-    // DEV_LOG("VAO", primitive.m_VAO);
     glGenBuffers(1, &primitive.m_VBO);
-    // DEV_LOG("VBO", primitive.m_VBO);
     glGenBuffers(1, &primitive.m_EBO);
-    // DEV_LOG("EBO", primitive.m_EBO);
-    // DEV_LOG("Cont", "");
 
-    glBindVertexArray(primitive.m_VAO);
-    // DEV_LOG("Binding VAO", "");
+    glWrap::StateCache& state = glWrap::StateCache::Current();
+
+    // The element binding belongs to the bound VAO, so none may be bound
+    state.BindVertexArray(0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, primitive.m_VBO);
+    state.BindBuffer(GL_ARRAY_BUFFER, primitive.m_VBO);
     glBufferData(GL_ARRAY_BUFFER, primitive.m_vertices.size() * sizeof(glWrap::Vertex), primitive.m_vertices.data(), GL_STATIC_DRAW);
-    // DEV_LOG("Vertex size", primitive.m_vertices.size());
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.m_EBO);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.m_EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, primitive.m_indices.size() * sizeof(GL_UNSIGNED_SHORT), primitive.m_indices.data(), GL_STATIC_DRAW);
-    // DEV_LOG("Index size", primitive.m_indices.size());
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+static void CreateVertexArray(glWrap::Primitive &primitive){
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    glGenVertexArrays(1, &primitive.m_VAO);
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    // DEV_LOG("Attrib arrays generated", "");
+    glWrap::StateCache& state = glWrap::StateCache::Current();
+
+    state.BindVertexArray(primitive.m_VAO);
+    state.BindBuffer(GL_ARRAY_BUFFER, primitive.m_VBO);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.m_EBO);
+
+    SetVertexAttributes();
 
-    glBindVertexArray(0);
+    state.BindVertexArray(0);
+}
 
-    // DEV_LOG("DONE", "");
+void CreateGlObjects(glWrap::Primitive &primitive){
+    CreateBuffers(primitive);
+    CreateVertexArray(primitive);
 }
 
 static GLenum GetChannelType(unsigned int channels){
@@ -186,357 +318,4931 @@ static GLenum GetChannelType(unsigned int channels){
     return GL_RGB;
 }
 
-// 
-// *TEXTURE
-// 
+// Sort key layout, most significant bits first. Opaque draws are grouped by state and
+// ordered front to back inside a group, transparent draws are ordered back to front.
+// Opaque:      pass 2 | shader 14 | texture set 12 | VAO 16 | depth 20
+// Transparent: pass 2 | inverted depth 20 | shader 14 | texture set 12 | VAO 16
+static uint64_t PackSortKey(bool transparent, unsigned int shader, unsigned int textures, unsigned int vao, float depth){
+    uint64_t pass = transparent ? 1 : 0;
+    uint64_t depthBits = (uint64_t)(glm::clamp(depth, 0.0f, 1.0f) * 0xFFFFF);
+    uint64_t state = ((uint64_t)(shader & 0x3FFF) << 28) | ((uint64_t)(textures & 0xFFF) << 16) | (vao & 0xFFFF);
 
-glWrap::Texture2D::Texture2D(std::string image, bool flip, GLenum filter, GLenum desiredChannels){
-    stbi_set_flip_vertically_on_load(flip);
-    int width, height, channels;
-    unsigned char *data = stbi_load(image.c_str(), &width, &height, &channels, 0);
+    if (transparent) return (pass << 62) | ((0xFFFFF - depthBits) << 42) | state;
 
-    // std::cout << channels << " channels\n";
+    return (pass << 62) | (state << 20) | depthBits;
+}
 
-    glGenTextures(1, &m_ID);
-    glBindTexture(GL_TEXTURE_2D, m_ID);
+// LSD radix sort on the 64 bit keys, 16 bits per pass. Passes where every key shares the
+// same digit are skipped, which is the common case for the high pass and shader bits.
+static void RadixSort(std::vector<glWrap::DrawItem>& items, std::vector<glWrap::DrawItem>& scratch){
+    if (items.size() < 2) return;
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    scratch.resize(items.size());
 
-    if(data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, desiredChannels, width, height, 0, GetChannelType(channels), GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else std::cout << "Texture not loaded correctly\n";
+    std::vector<unsigned int> offsets(0x10000);
 
-    stbi_image_free(data);
-}
+    for (int shift{}; shift < 64; shift += 16){
+        std::fill(offsets.begin(), offsets.end(), 0);
 
-void glWrap::Texture2D::SetActive(unsigned int unit){
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, m_ID);
+        for (const glWrap::DrawItem& item : items) ++offsets[(item.key >> shift) & 0xFFFF];
+
+        if (offsets[(items[0].key >> shift) & 0xFFFF] == items.size()) continue;
+
+        unsigned int sum{};
+        for (unsigned int& offset : offsets){
+            unsigned int count = offset;
+            offset = sum;
+            sum += count;
+        }
+
+        for (const glWrap::DrawItem& item : items) scratch[offsets[(item.key >> shift) & 0xFFFF]++] = item;
+
+        items.swap(scratch);
+    }
 }
 
 // 
-// *SHADER
+// *Jobs
 // 
 
-glWrap::Shader::Shader(std::string vertexPath, std::string fragmentPath){
-    
-    unsigned int vertex, fragment; // Shader objects
-
-    CreateShader(vertex, GL_VERTEX_SHADER, ExtractFile(vertexPath));
-    CreateShader(fragment, GL_FRAGMENT_SHADER, ExtractFile(fragmentPath));
+// The system and deque of the calling thread, threads outside every system use the shared deque
+static thread_local glWrap::JobSystem* currentJobSystem{nullptr};
+static thread_local unsigned int currentJobQueue{0};
 
+bool glWrap::JobCounter::IsDone() const { return m_value.load() == 0; }
 
-    m_ID = glCreateProgram();
-    glAttachShader(m_ID, vertex);
-    glAttachShader(m_ID, fragment);
+glWrap::JobSystem::JobSystem(unsigned int threads){
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
 
-    glLinkProgram(m_ID);
+    for (unsigned int i{}; i < threads; ++i) m_queues.push_back(std::make_unique<Queue>());
+    for (unsigned int i{1}; i < threads; ++i) m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
 
-    int success; // Error handle type
-    char log[512]; // Error message
-    glGetProgramiv(m_ID, GL_LINK_STATUS, &success);
-    if(!success)
+glWrap::JobSystem::~JobSystem(){
     {
-        glGetProgramInfoLog(m_ID, 512, NULL, log);
-        DEV_LOG("Failed linking: ", log);
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
     }
+    m_wake.notify_all();
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-
-    return;
+    for (std::thread& worker : m_workers) worker.join();
 }
 
-glWrap::Shader::Shader(const char* vertexShader, const char* fragmentShader, bool isText){
-    unsigned int vertex, fragment; // Shader objects
-
-    CreateShader(vertex, GL_VERTEX_SHADER, vertexShader);
-    CreateShader(fragment, GL_FRAGMENT_SHADER, fragmentShader);
-
-    m_ID = glCreateProgram();
-    glAttachShader(m_ID, vertex);
-    glAttachShader(m_ID, fragment);
+glWrap::JobSystem& glWrap::JobSystem::Default(){
+    static JobSystem system;
+    return system;
+}
 
-    glLinkProgram(m_ID);
+unsigned int glWrap::JobSystem::GetQueueIndex(){ return currentJobSystem == this ? currentJobQueue : 0; }
+unsigned int glWrap::JobSystem::GetThreadCount(){ return (unsigned int)m_workers.size() + 1; }
 
-    int success; // Error handle type
-    char log[512]; // Error message
-    glGetProgramiv(m_ID, GL_LINK_STATUS, &success);
-    if(!success)
+void glWrap::JobSystem::Push(std::function<void()> job, JobCounter* counter){
+    Queue& queue = *m_queues[GetQueueIndex()];
     {
-        glGetProgramInfoLog(m_ID, 512, NULL, log);
-        DEV_LOG("Failed linking: ", log);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.emplace_back(std::move(job), counter);
+        ++m_queued;
     }
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-
-    return;
+    // A worker going to sleep either sees the queued job or is counted here
+    if (m_sleeping.load()){
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_one();
+    }
 }
 
-void glWrap::Shader::Use(){
-    glUseProgram(m_ID);
+void glWrap::JobSystem::Run(std::function<void()> job, JobCounter* counter, JobCounter* dependency){
+    if (counter) ++counter->m_value;
+
+    if (dependency){
+        std::lock_guard<std::mutex> lock(dependency->m_mutex);
+        if (dependency->m_value.load() > 0){
+            dependency->m_waiting.emplace_back(std::move(job), counter);
+            return;
+        }
+    }
+
+    Push(std::move(job), counter);
 }
 
-void glWrap::Shader::Update(){
-    for (auto const& value : m_bools){
-        if (glGetUniformLocation(m_ID, value.first.c_str()) != -1)
-            glUniform1i(glGetUniformLocation(m_ID, value.first.c_str()), (int)value.second);
+void glWrap::JobSystem::RunBackground(std::function<void()> job, JobCounter* counter){
+    if (m_workers.empty()){
+        job();
+        return;
     }
 
-    for (auto const& value : m_ints){
-        if (glGetUniformLocation(m_ID, value.first.c_str()) != -1)
-        glUniform1i(glGetUniformLocation(m_ID, value.first.c_str()), value.second);
+    if (counter) ++counter->m_value;
+    {
+        std::lock_guard<std::mutex> lock(m_background.mutex);
+        m_background.jobs.emplace_back(std::move(job), counter);
+        ++m_queued;
     }
 
-    for (auto const& value : m_floats){
-        if (glGetUniformLocation(m_ID, value.first.c_str()) != -1)
-        glUniform1f(glGetUniformLocation(m_ID, value.first.c_str()), value.second);
+    if (m_sleeping.load()){
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_one();
     }
+}
+
+bool glWrap::JobSystem::RunOne(unsigned int index){
+    if (m_queued.load() == 0) return false;
+
+    std::pair<std::function<void()>, JobCounter*> job;
+
+    // Newest job of the own deque keeps its data in cache, the others lose their oldest
+    for (size_t i{}; i < m_queues.size() && !job.first; ++i){
+        Queue& queue = *m_queues[(index + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) continue;
 
-    for (auto const& value : m_mat4s){
-        if (glGetUniformLocation(m_ID, value.first.c_str()) != -1)
-        glUniformMatrix4fv(glGetUniformLocation(m_ID, value.first.c_str()), 1, GL_FALSE, glm::value_ptr(value.second));
+        if (i == 0){
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        else {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+
+        --m_queued;
     }
 
-    unsigned int unit = 0;
-    for (auto const& value : m_textures){
-        if (glGetUniformLocation(m_ID, value.first.c_str()) != -1){
-            value.second->SetActive(unit);
-            glUniform1i(glGetUniformLocation(m_ID, value.first.c_str()), unit);
-            ++unit;
+    // Only workers, which wait on nothing, take background jobs
+    if (!job.first && index != 0){
+        std::lock_guard<std::mutex> lock(m_background.mutex);
+        if (!m_background.jobs.empty()){
+            job = std::move(m_background.jobs.front());
+            m_background.jobs.pop_front();
+            --m_queued;
         }
     }
+
+    if (!job.first) return false;
+
+    job.first();
+    Finish(job.second);
+    return true;
 }
 
-void glWrap::Shader::SetBool(const std::string name, bool value){ m_bools[name] = value; }
-void glWrap::Shader::SetInt(const std::string name, int value){ m_ints[name] = value; }
-void glWrap::Shader::SetFloat(const std::string name, float value){ m_floats[name] = value; }
-void glWrap::Shader::SetMatrix4(const std::string name, glm::mat4 mat){ m_mat4s[name] = mat; }
-void glWrap::Shader::SetTexture(const std::string name, Texture2D* texture){ m_textures[name] = texture; }
+void glWrap::JobSystem::Finish(JobCounter* counter){
+    if (!counter) return;
 
-// 
-// *WorldObject
-//
+    std::vector<std::pair<std::function<void()>, JobCounter*>> released;
+    {
+        // Wait takes the lock before returning, so the counter outlives this block
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (--counter->m_value == 0) released.swap(counter->m_waiting);
+    }
 
-glm::vec3 glWrap::WorldObject::GetForwardVector(){
-    return glm::normalize(glm::vec3{
-        (cos(glm::radians(m_transform.rot.z)) * cos(glm::radians(m_transform.rot.y))),
-        sin(glm::radians(m_transform.rot.y)),
-        (sin(glm::radians(m_transform.rot.z)) * cos(glm::radians(m_transform.rot.y)))});
+    for (auto& job : released) Push(std::move(job.first), job.second);
 }
 
-glm::vec3 glWrap::WorldObject::GetRightVector(){ return glm::normalize(glm::cross(GetForwardVector(), glm::vec3(0.0f, 1.0f, 0.0f))); }
+void glWrap::JobSystem::Wait(JobCounter& counter){
+    unsigned int index = GetQueueIndex();
 
-glm::vec3 glWrap::WorldObject::GetUpwardVector(){ return glm::normalize(glm::cross(GetRightVector(), GetForwardVector())); }
+    while (!counter.IsDone()){
+        if (!RunOne(index)) std::this_thread::yield();
+    }
 
-glm::mat4 glWrap::WorldObject::GetTransformMatrix(){
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
 
-    glm::mat4 model = glm::mat4(1.0f);
+void glWrap::JobSystem::WorkerLoop(unsigned int index){
+    currentJobSystem = this;
+    currentJobQueue = index;
 
-    model = glm::translate(model, m_transform.pos);
-    model = glm::scale(model, m_transform.scl);
-    model = glm::rotate(model, glm::radians(m_transform.rot.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    model = glm::rotate(model, glm::radians(m_transform.rot.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::rotate(model, glm::radians(m_transform.rot.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    while (!m_stopping.load()){
+        if (RunOne(index)) continue;
 
-    return model;
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        ++m_sleeping;
+        m_wake.wait(lock, [this]{ return m_queued.load() > 0 || m_stopping.load(); });
+        --m_sleeping;
+    }
 }
 
-void glWrap::WorldObject::SetTransform(Transform transform){ m_transform = transform; }
-void glWrap::WorldObject::SetPosition(glm::vec3 position){ m_transform.pos = position; }
-void glWrap::WorldObject::SetRotation(glm::vec3 rotation){ m_transform.rot = rotation; }
-void glWrap::WorldObject::SetScale(glm::vec3 scale){ m_transform.scl = scale; }
-
-void glWrap::WorldObject::AddPosition(glm::vec3 position){ m_transform.pos += position; }
-void glWrap::WorldObject::AddRotation(glm::vec3 rotation){ m_transform.rot += rotation; }
-void glWrap::WorldObject::AddScale(glm::vec3 scale){ m_transform.scl += scale; }
+void glWrap::JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body){
+    // A few ranges per thread, so stealing can even out ranges that take longer
+    size_t ranges = GetThreadCount() * 4;
+    size_t size = std::max(std::max(grain, (size_t)1), (count + ranges - 1) / ranges);
 
-// 
-// *Camera
-// 
+    if (size >= count){
+        if (count) body(0, count);
+        return;
+    }
 
-float glWrap::Camera::GetFOV(){ return m_FOV; }
-glm::mat4 glWrap::Camera::GetView(){ return m_target ? glm::lookAt(m_transform.pos, *m_target, GetUpwardVector()) : glm::lookAt(m_transform.pos, m_transform.pos + GetForwardVector(), GetUpwardVector()); }
-glm::mat4 glWrap::Camera::GetProjection(glm::vec2 aspect){ return m_perspective ? glm::perspective(glm::radians(m_FOV), (aspect.x / aspect.y), m_clip.x, m_clip.y ) : glm::ortho(0.0f, aspect.x, 0.0f, aspect.y, m_clip.x, m_clip.y); }
-bool glWrap::Camera::IsPerspective(){ return m_perspective; }
+    JobCounter counter;
+    for (size_t begin{size}; begin < count; begin += size){
+        Run([&body, begin, size, count](){ body(begin, std::min(begin + size, count)); }, &counter);
+    }
 
-void glWrap::Camera::SetTarget(glm::vec3* target){ m_target = target; }
-void glWrap::Camera::SetFOV(float FOV){ m_FOV = FOV; }
-void glWrap::Camera::AddFOV(float FOV){ m_FOV += FOV; }
-void glWrap::Camera::SetPerspective(bool isTrue){ m_perspective = isTrue; }
+    body(0, size);
+    Wait(counter);
+}
 
 // 
-// *Mesh / Primitive
+// *BOUNDS / FRUSTUM
 // 
 
-void glWrap::Primitive::Draw(){
+bool glWrap::AABB::IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+glm::vec3 glWrap::AABB::GetCenter() const { return (min + max) * 0.5f; }
+glm::vec3 glWrap::AABB::GetExtent() const { return (max - min) * 0.5f; }
 
-    // DEV_LOG("Binding VAO: ", m_VAO);
-    glBindVertexArray(m_VAO);
-    // DEV_LOG("Binding EBO: ", m_EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+void glWrap::AABB::Expand(glm::vec3 point){
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
 
-    // DEV_LOG("Drawing elements", "");
-    glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_SHORT, 0);
+void glWrap::AABB::Expand(const AABB& box){
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
 }
 
-// 
-// *Instance
-// 
+glWrap::AABB glWrap::AABB::Transformed(const glm::mat4& matrix) const {
+    if (IsEmpty()) return *this;
 
-void glWrap::Instance::SetMesh(Mesh* mesh){
-    m_mesh = mesh;
-    m_shaders.resize(mesh->m_primitives.size());
-    // DEV_LOG("Shaders required: ", m_shaders.size());
-}
+    // Arvo's method: the new extent is the absolute rotation-scale part applied to the old one
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(GetCenter(), 1.0f));
+    glm::vec3 extent = GetExtent();
+    glm::vec3 newExtent = glm::abs(glm::vec3(matrix[0])) * extent.x + glm::abs(glm::vec3(matrix[1])) * extent.y + glm::abs(glm::vec3(matrix[2])) * extent.z;
 
-void glWrap::Instance::SetShader(Shader* shader, int primitive){
-    if (primitive < m_shaders.size()){
-        m_shaders[primitive] = shader;
-    }
-    else {
-        DEV_LOG("Wrong primitive index, max is: ", m_shaders.size() - 1);
-    }
+    return {center - newExtent, center + newExtent};
 }
 
-void glWrap::Instance::SetVisibility(bool visibility){ m_visible = visibility; }
-
-glWrap::Mesh* glWrap::Instance::GetMesh(){ return m_mesh; }
+void glWrap::BoxList::Add(const AABB& box){
+    // Empty boxes get an infinite extent so they are never culled
+    glm::vec3 center = box.IsEmpty() ? glm::vec3(0.0f) : box.GetCenter();
+    glm::vec3 extent = box.IsEmpty() ? glm::vec3(std::numeric_limits<float>::max()) : box.GetExtent();
+
+    m_cx.push_back(center.x);
+    m_cy.push_back(center.y);
+    m_cz.push_back(center.z);
+    m_ex.push_back(extent.x);
+    m_ey.push_back(extent.y);
+    m_ez.push_back(extent.z);
+}
 
-glWrap::Shader* glWrap::Instance::GetShader(int primitive){
-    if (primitive < m_shaders.size()){
-        return m_shaders[primitive];
-    }
-    else {
-        // DEV_LOG("Wrong primitive index, max is: ", m_shaders.size() - 1);
-        return nullptr;
-    }
+void glWrap::BoxList::Clear(){
+    m_cx.clear();
+    m_cy.clear();
+    m_cz.clear();
+    m_ex.clear();
+    m_ey.clear();
+    m_ez.clear();
 }
 
-bool glWrap::Instance::GetVisibility(){ return m_visible; }
+size_t glWrap::BoxList::Size() const { return m_cx.size(); }
 
-// 
-// *Window
-// 
+glWrap::Frustum::Frustum(const glm::mat4& viewProjection){
+    glm::vec4 rows[4];
+    for (int i{}; i < 4; ++i) rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
 
-std::vector<unsigned int> glWrap::Window::m_pressedKeys;
-std::vector<unsigned int> glWrap::Window::m_releasedKeys;
-std::vector<unsigned int> glWrap::Window::m_repeatKeys;
-glm::dvec2 glWrap::Window::m_lastMousePos;
-glm::dvec2 glWrap::Window::m_deltaMousePos;
-glm::ivec2 glWrap::Window::m_size;
+    m_planes[0] = rows[3] + rows[0]; // Left
+    m_planes[1] = rows[3] - rows[0]; // Right
+    m_planes[2] = rows[3] + rows[1]; // Bottom
+    m_planes[3] = rows[3] - rows[1]; // Top
+    m_planes[4] = rows[3] + rows[2]; // Near
+    m_planes[5] = rows[3] - rows[2]; // Far
+
+    for (glm::vec4& plane : m_planes) plane /= glm::length(glm::vec3(plane));
+}
 
-glWrap::Window::Window(std::string name, glm::ivec2 size) : m_name{name}{
+bool glWrap::Frustum::Intersects(const AABB& box) const {
+    glm::vec3 center = box.GetCenter();
+    glm::vec3 extent = box.GetExtent();
 
-    if(!glfwInit()){
-        DEV_LOG("Failed to initialize OPENGL", "");
-        return;
+    for (const glm::vec4& plane : m_planes){
+        glm::vec3 normal = glm::vec3(plane);
+        if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.0f) return false;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    return true;
+}
 
-    m_window = glfwCreateWindow(size.x, size.y, name.c_str(), NULL, NULL);
+int glWrap::Frustum::Classify(const AABB& box) const {
+    glm::vec3 center = box.GetCenter();
+    glm::vec3 extent = box.GetExtent();
+    int result = 1;
 
-    glfwMakeContextCurrent(m_window);
+    for (const glm::vec4& plane : m_planes){
+        glm::vec3 normal = glm::vec3(plane);
+        float distance = glm::dot(normal, center) + plane.w;
+        float radius = glm::dot(glm::abs(normal), extent);
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        DEV_LOG("Failed to initialize GLAD for window ", name);
-        glfwTerminate();
+        if (distance + radius < 0.0f) return -1;
+        if (distance - radius < 0.0f) result = 0;
     }
 
-    glEnable(GL_DEPTH_TEST);
-
-    m_defaultShader = std::make_unique<Shader>(defaultVertexShader, defaultFragmentShader, true);
-    m_size = size;
+    return result;
+}
 
-    glfwSetKeyCallback(m_window, keyCall);
-    glfwSetFramebufferSizeCallback(m_window, frameCall);
-    // glfwSetCursorPosCallback(m_window, mousePosCall);
-    glfwGetCursorPos(m_window, &m_lastMousePos.x, &m_lastMousePos.y);
+void glWrap::Frustum::Cull(const BoxList& boxes, std::vector<unsigned char>& visible) const {
+    visible.resize(boxes.Size());
+    Cull(boxes, visible, 0, boxes.Size());
 }
 
-/*
-glWrap::Window::Window(std::string name, glm::ivec2 size, GLFWwindow* context) : m_name{name}{
+void glWrap::Frustum::Cull(const BoxList& boxes, std::vector<unsigned char>& visible, JobSystem& jobs) const {
+    visible.resize(boxes.Size());
+    jobs.ParallelFor(boxes.Size(), 16384, [&](size_t begin, size_t end){ Cull(boxes, visible, begin, end); });
+}
 
-    m_window = glfwCreateWindow(size.x, size.y, name.c_str(), NULL, context);
+void glWrap::Frustum::Cull(const BoxList& boxes, std::vector<unsigned char>& visible, size_t begin, size_t end) const {
+    size_t count = end;
+    size_t i{begin};
+
+    // A box is outside when its center is further behind a plane than its projected radius
+#if defined(GW_SIMD_AVX)
+    for (; i + 8 <= count; i += 8){
+        __m256 cx = _mm256_loadu_ps(&boxes.m_cx[i]), cy = _mm256_loadu_ps(&boxes.m_cy[i]), cz = _mm256_loadu_ps(&boxes.m_cz[i]);
+        __m256 ex = _mm256_loadu_ps(&boxes.m_ex[i]), ey = _mm256_loadu_ps(&boxes.m_ey[i]), ez = _mm256_loadu_ps(&boxes.m_ez[i]);
+        __m256 outside = _mm256_setzero_ps();
+
+        for (const glm::vec4& plane : m_planes){
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx), _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+                                            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz), _mm256_set1_ps(plane.w)));
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), ey)),
+                                          _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
 
-    glfwMakeContextCurrent(m_window);
+        int mask = _mm256_movemask_ps(outside);
+        for (int lane{}; lane < 8; ++lane) visible[i + lane] = !((mask >> lane) & 1);
+    }
+#elif defined(GW_SIMD_SSE)
+    for (; i + 4 <= count; i += 4){
+        __m128 cx = _mm_loadu_ps(&boxes.m_cx[i]), cy = _mm_loadu_ps(&boxes.m_cy[i]), cz = _mm_loadu_ps(&boxes.m_cz[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.m_ex[i]), ey = _mm_loadu_ps(&boxes.m_ey[i]), ez = _mm_loadu_ps(&boxes.m_ez[i]);
+        __m128 outside = _mm_setzero_ps();
+
+        for (const glm::vec4& plane : m_planes){
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+                                       _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        DEV_LOG("Failed to initialize GLAD for window ", name);
-        glfwTerminate();
+        int mask = _mm_movemask_ps(outside);
+        for (int lane{}; lane < 4; ++lane) visible[i + lane] = !((mask >> lane) & 1);
     }
+#endif
 
-    glEnable(GL_DEPTH_TEST);
+    for (; i < count; ++i){
+        bool inside = true;
 
-    m_defaultShader = std::make_unique<Shader>(defaultVertexShader, defaultFragmentShader, true);
-    m_lastMousePos = { (size.x / 2), (size.y / 2) };
-    m_size = size;
+        for (const glm::vec4& plane : m_planes){
+            float distance = plane.x * boxes.m_cx[i] + plane.y * boxes.m_cy[i] + plane.z * boxes.m_cz[i] + plane.w;
+            float radius = std::abs(plane.x) * boxes.m_ex[i] + std::abs(plane.y) * boxes.m_ey[i] + std::abs(plane.z) * boxes.m_ez[i];
+            if (distance + radius < 0.0f) inside = false;
+        }
 
-    glfwSetKeyCallback(m_window, keyCall);
-    glfwSetFramebufferSizeCallback(m_window, frameCall);
-    // glfwSetCursorPosCallback(m_window, mousePosCall);
-    glfwGetCursorPos(m_window, &m_lastMousePos.x, &m_lastMousePos.y);
+        visible[i] = inside;
+    }
 }
-*/
-
-void glWrap::Window::Swap(){
 
-    glfwSwapBuffers(m_window);
-    glClearColor(m_color.r, m_color.b, m_color.g, m_color.a);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+const glm::vec4* glWrap::Frustum::GetPlanes() const { return m_planes; }
 
-    m_pressedKeys.clear();
-    m_releasedKeys.clear();
-    m_repeatKeys.clear();
-    glfwPollEvents();
+// 
+// *STATE CACHE
+// 
 
-    glm::dvec2 pos;
-    glfwGetCursorPos(m_window, &pos.x, &pos.y);
-    m_deltaMousePos = { (pos.x - m_lastMousePos.x), (m_lastMousePos.y - pos.y) };
-    m_lastMousePos = pos;
+const GLuint glWrap::StateCache::unknown;
 
-    m_deltaTime = glfwGetTime() - m_lastFrameTime;
-    m_lastFrameTime = glfwGetTime();
+glWrap::StateCache::StateCache(){ Invalidate(); }
 
-    if (!m_firstFrame) return;
-    
-    m_deltaTime = 0.0f;
-    m_lastFrameTime = glfwGetTime();
-    m_firstFrame = false;
+glWrap::StateCache& glWrap::StateCache::Current(){
+    thread_local StateCache cache;
+    return cache;
 }
 
-void glWrap::Window::Draw(Instance& instance){
+void glWrap::StateCache::Invalidate(){
+    m_program = unknown;
+    m_vertexArray = unknown;
+    m_buffers.clear();
+    m_activeUnit = unknown;
+    m_textures2D.fill(unknown);
+    m_texturesArray.fill(unknown);
+    m_samplers.fill(unknown);
+    m_capabilities.clear();
+    m_depthMask = unknown;
+    m_blendSrc = unknown;
+    m_blendDst = unknown;
+    m_viewport = glm::ivec4(-1);
+}
 
-    if (instance.GetMesh() && instance.GetVisibility() && m_ActiveCamera){
+bool glWrap::StateCache::Filter(bool redundant){
+    redundant ? ++m_stats.filtered : ++m_stats.issued;
+    return redundant;
+}
 
-        for (int i{}; i < instance.GetMesh()->m_primitives.size(); ++i){
+GLuint* glWrap::StateCache::TextureSlot(unsigned int unit, GLenum target){
+    if (unit >= maxUnits) return nullptr;
 
-            if (m_currentShader != (instance.GetShader(i) ? instance.GetShader(i) : m_defaultShader.get())){
-                m_currentShader = instance.GetShader(i) ? instance.GetShader(i) : m_defaultShader.get();
-                m_currentShader->Use();
-            }
-            
-            m_currentShader->Update();
+    switch (target){
+        case GL_TEXTURE_2D:
+        return &m_textures2D[unit];
 
-            instance.GetMesh()->m_primitives[i].Draw();
-        }
+        case GL_TEXTURE_2D_ARRAY:
+        return &m_texturesArray[unit];
     }
+
+    return nullptr;
 }
 
-bool glWrap::Window::IsKeyHeld(unsigned int key) { return glfwGetKey(m_window, key) == GLFW_PRESS; }
-bool glWrap::Window::IsRequestedClose() { return glfwWindowShouldClose(m_window); }
+void glWrap::StateCache::UseProgram(GLuint program){
+    if (Filter(m_program == program)) return;
+    m_program = program;
+    glUseProgram(program);
+}
 
-float glWrap::Window::GetDeltaTime(){ return m_deltaTime; }
+void glWrap::StateCache::BindVertexArray(GLuint vertexArray){
+    if (Filter(m_vertexArray == vertexArray)) return;
+    m_vertexArray = vertexArray;
+    glBindVertexArray(vertexArray);
+
+    // The element buffer binding is part of the VAO
+    for (auto& buffer : m_buffers){
+        if (buffer.first == GL_ELEMENT_ARRAY_BUFFER) buffer.second = unknown;
+    }
+}
+
+void glWrap::StateCache::BindBuffer(GLenum target, GLuint buffer){
+    auto it = std::find_if(m_buffers.begin(), m_buffers.end(), [target](const std::pair<GLenum, GLuint>& value){ return value.first == target; });
+
+    if (it == m_buffers.end()) it = m_buffers.insert(m_buffers.end(), {target, unknown});
+
+    if (Filter(it->second == buffer)) return;
+    it->second = buffer;
+    glBindBuffer(target, buffer);
+}
+
+void glWrap::StateCache::BindTexture(unsigned int unit, GLenum target, GLuint texture){
+    GLuint* slot = TextureSlot(unit, target);
+
+    if (slot && Filter(*slot == texture)) return;
+    if (slot) *slot = texture;
+    else ++m_stats.issued;
+
+    if (m_activeUnit != unit){
+        m_activeUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    glBindTexture(target, texture);
+}
+
+void glWrap::StateCache::BindSampler(unsigned int unit, GLuint sampler){
+    if (unit < maxUnits && Filter(m_samplers[unit] == sampler)) return;
+    if (unit < maxUnits) m_samplers[unit] = sampler;
+    glBindSampler(unit, sampler);
+}
+
+void glWrap::StateCache::SetCapability(GLenum capability, bool enabled){
+    auto it = std::find_if(m_capabilities.begin(), m_capabilities.end(), [capability](const std::pair<GLenum, bool>& value){ return value.first == capability; });
+
+    if (it != m_capabilities.end() && Filter(it->second == enabled)) return;
+
+    if (it == m_capabilities.end()){
+        ++m_stats.issued;
+        m_capabilities.push_back({capability, enabled});
+    }
+    else it->second = enabled;
+
+    enabled ? glEnable(capability) : glDisable(capability);
+}
+
+void glWrap::StateCache::SetDepthMask(bool enabled){
+    if (Filter(m_depthMask == (GLuint)enabled)) return;
+    m_depthMask = enabled;
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void glWrap::StateCache::SetBlendFunc(GLenum source, GLenum destination){
+    if (Filter(m_blendSrc == source && m_blendDst == destination)) return;
+    m_blendSrc = source;
+    m_blendDst = destination;
+    glBlendFunc(source, destination);
+}
+
+void glWrap::StateCache::SetViewport(glm::ivec4 viewport){
+    if (Filter(m_viewport == viewport)) return;
+    m_viewport = viewport;
+    glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+}
+
+void glWrap::StateCache::DeleteProgram(GLuint program){
+    if (m_program == program) m_program = unknown;
+    glDeleteProgram(program);
+}
+
+void glWrap::StateCache::DeleteVertexArray(GLuint vertexArray){
+    if (m_vertexArray == vertexArray) m_vertexArray = 0;
+    glDeleteVertexArrays(1, &vertexArray);
+}
+
+void glWrap::StateCache::DeleteBuffer(GLuint buffer){
+    for (auto& value : m_buffers){
+        if (value.second == buffer) value.second = unknown;
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void glWrap::StateCache::DeleteTexture(GLuint texture){
+    for (unsigned int unit{}; unit < maxUnits; ++unit){
+        if (m_textures2D[unit] == texture) m_textures2D[unit] = unknown;
+        if (m_texturesArray[unit] == texture) m_texturesArray[unit] = unknown;
+    }
+    glDeleteTextures(1, &texture);
+}
+
+void glWrap::StateCache::DeleteSampler(GLuint sampler){
+    for (GLuint& slot : m_samplers){
+        if (slot == sampler) slot = unknown;
+    }
+    glDeleteSamplers(1, &sampler);
+}
+
+glWrap::StateCache::Stats glWrap::StateCache::GetStats(){ return m_stats; }
+void glWrap::StateCache::ResetStats(){ m_stats = {}; }
+
+// 
+// *TEXTURE
+// 
+
+static std::mutex samplerMutex;
+static std::map<glWrap::SamplerState, GLuint> samplers;
+
+bool glWrap::SamplerState::operator<(const SamplerState& other) const {
+    return std::tie(minFilter, magFilter, wrapS, wrapT, anisotropy) < std::tie(other.minFilter, other.magFilter, other.wrapS, other.wrapT, other.anisotropy);
+}
+
+GLuint glWrap::SamplerCache::Get(const SamplerState& state){
+    std::lock_guard<std::mutex> lock(samplerMutex);
+    GLuint& sampler = samplers[state];
+    if (sampler) return sampler;
+
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, state.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, state.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, state.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, state.wrapT);
+    if (state.anisotropy > 1.0f && maxAnisotropy > 1.0f) glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, std::min(state.anisotropy, maxAnisotropy));
+
+    return sampler;
+}
+
+void glWrap::SamplerCache::Clear(){
+    std::lock_guard<std::mutex> lock(samplerMutex);
+    for (auto& sampler : samplers) StateCache::Current().DeleteSampler(sampler.second);
+    samplers.clear();
+}
+
+size_t glWrap::SamplerCache::Size(){
+    std::lock_guard<std::mutex> lock(samplerMutex);
+    return samplers.size();
+}
+
+static int BlockBytes(GLenum format){ // Every supported format packs 4x4 pixels
+    switch (format){
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1: case GL_COMPRESSED_RGB8_ETC2: case GL_COMPRESSED_SRGB8_ETC2:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC: case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        return 16;
+    }
+
+    return 0;
+}
+
+static int MipCount(glm::ivec2 size){ return 1 + (int)std::log2(std::max(size.x, size.y)); }
+
+static size_t LevelBytes(GLenum format, int width, int height){ // Plain formats are RGBA8
+    int blockBytes = BlockBytes(format);
+    if (!blockBytes) return (size_t)width * height * 4;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+static bool IsFormatSupported(GLenum format){
+    switch (format){
+    case GL_COMPRESSED_RED_RGTC1: case GL_COMPRESSED_RG_RGTC2:
+        return true;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return compressionBPTC;
+    case GL_COMPRESSED_RGB8_ETC2: case GL_COMPRESSED_SRGB8_ETC2: case GL_COMPRESSED_RGBA8_ETC2_EAC: case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        return compressionETC2;
+    }
+
+    return compressionS3TC;
+}
+
+static bool IsSrgb(GLenum format){
+    return format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+        || format == GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM || format == GL_COMPRESSED_SRGB8_ETC2 || format == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+}
+
+static GLenum StorageFormat(GLenum format){ // Formats the context lacks are decoded to RGBA8
+    if (!BlockBytes(format) || IsFormatSupported(format)) return format;
+    return IsSrgb(format) ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+}
+
+static unsigned char ClampByte(int value){ return (unsigned char)std::min(255, std::max(0, value)); }
+
+// Block decoders for contexts lacking a format, each writes 16 RGBA pixels row by row
+
+static void DecodeBC1(const unsigned char* block, unsigned char* out, bool alpha, bool fourColors){
+    unsigned int c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+    unsigned int indices = block[4] | block[5] << 8 | block[6] << 16 | (unsigned int)block[7] << 24;
+
+    int colors[4][4];
+    for (int i{}; i < 2; ++i){
+        unsigned int c = i ? c1 : c0;
+        colors[i][0] = (c >> 11 & 31) << 3 | (c >> 13 & 7);
+        colors[i][1] = (c >> 5 & 63) << 2 | (c >> 9 & 3);
+        colors[i][2] = (c & 31) << 3 | (c >> 2 & 7);
+        colors[i][3] = 255;
+    }
+
+    // BC3 color blocks always use four colors, otherwise the order of the endpoints picks the mode
+    fourColors = fourColors || c0 > c1;
+
+    for (int k{}; k < 3; ++k){
+        if (fourColors){
+            colors[2][k] = (2 * colors[0][k] + colors[1][k]) / 3;
+            colors[3][k] = (colors[0][k] + 2 * colors[1][k]) / 3;
+        }
+        else {
+            colors[2][k] = (colors[0][k] + colors[1][k]) / 2;
+            colors[3][k] = 0;
+        }
+    }
+    colors[2][3] = 255;
+    colors[3][3] = fourColors || !alpha ? 255 : 0;
+
+    for (int i{}; i < 16; ++i){
+        for (int k{}; k < 4; ++k) out[i * 4 + k] = colors[indices >> (2 * i) & 3][k];
+    }
+}
+
+static void DecodeBC4(const unsigned char* block, unsigned char* out, int channel){
+    int a0 = block[0], a1 = block[1];
+    uint64_t indices{};
+    for (int i{}; i < 6; ++i) indices |= (uint64_t)block[2 + i] << (8 * i);
+
+    int values[8] = {a0, a1};
+    for (int i{}; i < 6; ++i){
+        values[2 + i] = a0 > a1 ? ((6 - i) * a0 + (1 + i) * a1) / 7 : i < 4 ? ((4 - i) * a0 + (1 + i) * a1) / 5 : i == 4 ? 0 : 255;
+    }
+
+    for (int i{}; i < 16; ++i) out[i * 4 + channel] = values[indices >> (3 * i) & 7];
+}
+
+static void DecodeETC2(const unsigned char* block, unsigned char* out){
+    static const int modifiers[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+    static const int distances[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+    uint32_t high = (uint32_t)block[0] << 24 | block[1] << 16 | block[2] << 8 | block[3];
+    uint32_t low = (uint32_t)block[4] << 24 | block[5] << 16 | block[6] << 8 | block[7];
+
+    auto extend4 = [](int c){ return c << 4 | c; };
+    auto extend5 = [](int c){ return c << 3 | c >> 2; };
+    auto signed3 = [](int c){ return c >= 4 ? c - 8 : c; };
+    auto index = [low](int x, int y){ int i = x * 4 + y; return (int)((low >> (16 + i) & 1) << 1 | (low >> i & 1)); }; // Pixels go column by column
+    auto write = [out](int x, int y, int r, int g, int b){
+        unsigned char* pixel = out + (y * 4 + x) * 4;
+        pixel[0] = ClampByte(r); pixel[1] = ClampByte(g); pixel[2] = ClampByte(b); pixel[3] = 255;
+    };
+
+    glm::ivec3 base[2];
+
+    if (high & 2){
+        int r = high >> 27 & 31, g = high >> 19 & 31, b = high >> 11 & 31;
+        int r2 = r + signed3(high >> 24 & 7), g2 = g + signed3(high >> 16 & 7), b2 = b + signed3(high >> 8 & 7);
+
+        // Overflowing differences select the modes ETC2 added
+        if (r2 < 0 || r2 > 31){ // T mode
+            glm::ivec3 c1{extend4((high >> 27 & 3) << 2 | (high >> 24 & 3)), extend4(high >> 20 & 15), extend4(high >> 16 & 15)};
+            glm::ivec3 c2{extend4(high >> 12 & 15), extend4(high >> 8 & 15), extend4(high >> 4 & 15)};
+            int d = distances[(high >> 2 & 3) << 1 | (high & 1)];
+            glm::ivec3 paint[4] = {c1, c2 + d, c2, c2 - d};
+
+            for (int y{}; y < 4; ++y){
+                for (int x{}; x < 4; ++x){ glm::ivec3 c = paint[index(x, y)]; write(x, y, c.r, c.g, c.b); }
+            }
+            return;
+        }
+
+        if (g2 < 0 || g2 > 31){ // H mode
+            int r1 = high >> 27 & 15, g1 = (high >> 24 & 7) << 1 | (high >> 20 & 1), b1 = (high >> 19 & 1) << 3 | (high >> 15 & 7);
+            int r2 = high >> 11 & 15, g2 = high >> 7 & 15, b2 = high >> 3 & 15;
+            int ordering = (r1 << 8 | g1 << 4 | b1) >= (r2 << 8 | g2 << 4 | b2);
+            int d = distances[(high >> 2 & 1) << 2 | (high & 1) << 1 | ordering];
+
+            glm::ivec3 c1{extend4(r1), extend4(g1), extend4(b1)}, c2{extend4(r2), extend4(g2), extend4(b2)};
+            glm::ivec3 paint[4] = {c1 + d, c1 - d, c2 + d, c2 - d};
+
+            for (int y{}; y < 4; ++y){
+                for (int x{}; x < 4; ++x){ glm::ivec3 c = paint[index(x, y)]; write(x, y, c.r, c.g, c.b); }
+            }
+            return;
+        }
+
+        if (b2 < 0 || b2 > 31){ // Planar mode, a gradient through three colors
+            auto extend6 = [](int c){ return c << 2 | c >> 4; };
+            auto extend7 = [](int c){ return c << 1 | c >> 6; };
+
+            glm::ivec3 o{extend6(high >> 25 & 63), extend7((high >> 24 & 1) << 6 | (high >> 17 & 63)),
+                         extend6((high >> 16 & 1) << 5 | (high >> 11 & 3) << 3 | (high >> 7 & 7))};
+            glm::ivec3 h{extend6((high >> 2 & 31) << 1 | (high & 1)), extend7(low >> 25 & 127), extend6(low >> 19 & 63)};
+            glm::ivec3 v{extend6(low >> 13 & 63), extend7(low >> 6 & 127), extend6(low & 63)};
+
+            for (int y{}; y < 4; ++y){
+                for (int x{}; x < 4; ++x){
+                    glm::ivec3 c = (x * (h - o) + y * (v - o) + 4 * o + 2) >> 2;
+                    write(x, y, c.r, c.g, c.b);
+                }
+            }
+            return;
+        }
+
+        base[0] = {extend5(r), extend5(g), extend5(b)};
+        base[1] = {extend5(r2), extend5(g2), extend5(b2)};
+    }
+    else {
+        base[0] = {extend4(high >> 28 & 15), extend4(high >> 20 & 15), extend4(high >> 12 & 15)};
+        base[1] = {extend4(high >> 24 & 15), extend4(high >> 16 & 15), extend4(high >> 8 & 15)};
+    }
+
+    // Two sub blocks side by side, or on top of each other when flipped
+    int tables[2] = {(int)(high >> 5 & 7), (int)(high >> 2 & 7)};
+    bool flip = high & 1;
+
+    for (int y{}; y < 4; ++y){
+        for (int x{}; x < 4; ++x){
+            int sub = flip ? y >= 2 : x >= 2;
+            int i = index(x, y);
+            int modifier = modifiers[tables[sub]][i & 1] * (i & 2 ? -1 : 1);
+            write(x, y, base[sub].r + modifier, base[sub].g + modifier, base[sub].b + modifier);
+        }
+    }
+}
+
+static void DecodeEAC(const unsigned char* block, unsigned char* out){
+    static const int modifiers[16][8] = {
+        {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12}, {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+        {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10}, {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+        {-2, -6, -8, -10, 1, 5, 7, 9}, {-2, -5, -8, -10, 1, 4, 7, 9}, {-2, -4, -8, -10, 1, 3, 7, 9}, {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9}, {-1, -2, -3, -10, 0, 1, 2, 9}, {-4, -6, -8, -9, 3, 5, 7, 8}, {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+    int base = block[0], multiplier = block[1] >> 4, table = block[1] & 15;
+    uint64_t indices{};
+    for (int i{}; i < 6; ++i) indices = indices << 8 | block[2 + i];
+
+    for (int x{}; x < 4; ++x){
+        for (int y{}; y < 4; ++y){
+            int i = x * 4 + y;
+            out[(y * 4 + x) * 4 + 3] = ClampByte(base + modifiers[table][indices >> (45 - 3 * i) & 7] * multiplier);
+        }
+    }
+}
+
+// BC7, every mode. The partition tables hold a bit (two subsets) or two bits (three subsets) per pixel
+static void DecodeBC7(const unsigned char* block, unsigned char* out){
+    struct Mode{ int subsets, partitionBits, rotationBits, selectionBits, colorBits, alphaBits, endpointP, sharedP, indexBits, secondaryBits; };
+    static const Mode modes[8] = {
+        {3, 4, 0, 0, 4, 0, 1, 0, 3, 0}, {2, 6, 0, 0, 6, 0, 0, 1, 3, 0}, {3, 6, 0, 0, 5, 0, 0, 0, 2, 0}, {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+        {1, 0, 2, 1, 5, 6, 0, 0, 2, 3}, {1, 0, 2, 0, 7, 8, 0, 0, 2, 2}, {1, 0, 0, 0, 7, 7, 1, 0, 4, 0}, {2, 6, 0, 0, 5, 5, 1, 0, 2, 0}};
+    static const uint16_t partitions2[64] = {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22};
+    static const uint32_t partitions3[64] = {
+        0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+        0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+        0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+        0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+        0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+        0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+        0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+        0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254};
+    // Pixels whose index drops its top bit, pixel 0 anchors the first subset
+    static const unsigned char anchors2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6, 6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+    static const unsigned char anchors3[2][64] = {
+        {3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3, 3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+         8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15, 3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3},
+        {15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8, 15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+         15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8, 15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8}};
+    static const int weights2[4] = {0, 21, 43, 64};
+    static const int weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+    static const int weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    int bit{};
+    auto read = [&](int count){
+        int value{};
+        for (int i{}; i < count; ++i, ++bit) value |= (block[bit >> 3] >> (bit & 7) & 1) << i;
+        return value;
+    };
+
+    int m{};
+    while (m < 8 && !read(1)) ++m;
+
+    if (m == 8){ // Reserved mode, decodes to transparent black
+        std::memset(out, 0, 64);
+        return;
+    }
+
+    const Mode& mode = modes[m];
+    int partition = read(mode.partitionBits), rotation = read(mode.rotationBits), selection = read(mode.selectionBits);
+
+    // Channel by channel, every endpoint of every subset in turn
+    int endpoints[3][2][4]{};
+    for (int c{}; c < 4; ++c){
+        int bits = c < 3 ? mode.colorBits : mode.alphaBits;
+        for (int s{}; s < mode.subsets; ++s){
+            for (int e{}; e < 2; ++e) endpoints[s][e][c] = bits ? read(bits) : 255;
+        }
+    }
+
+    int pbits[3][2]{};
+    for (int s{}; s < mode.subsets; ++s){
+        for (int e{}; e < 2; ++e) pbits[s][e] = mode.endpointP ? read(1) : 0;
+        if (mode.sharedP) pbits[s][0] = pbits[s][1] = read(1);
+    }
+
+    // The p bit extends every channel, then the top bits are repeated into the missing low ones
+    for (int s{}; s < mode.subsets; ++s){
+        for (int e{}; e < 2; ++e){
+            for (int c{}; c < 4; ++c){
+                int bits = c < 3 ? mode.colorBits : mode.alphaBits;
+                if (!bits) continue;
+
+                int value = endpoints[s][e][c];
+                if (mode.endpointP || mode.sharedP){
+                    value = value << 1 | pbits[s][e];
+                    ++bits;
+                }
+
+                value <<= 8 - bits;
+                endpoints[s][e][c] = value | value >> bits;
+            }
+        }
+    }
+
+    auto subset = [&](int i){
+        if (mode.subsets == 2) return (int)(partitions2[partition] >> i & 1);
+        if (mode.subsets == 3) return (int)(partitions3[partition] >> (2 * i) & 3);
+        return 0;
+    };
+
+    auto isAnchor = [&](int i){
+        if (mode.subsets == 2) return i == 0 || i == anchors2[partition];
+        if (mode.subsets == 3) return i == 0 || i == anchors3[0][partition] || i == anchors3[1][partition];
+        return i == 0;
+    };
+
+    int indices[16], secondary[16]{};
+    for (int i{}; i < 16; ++i) indices[i] = read(mode.indexBits - isAnchor(i));
+    for (int i{}; i < 16 && mode.secondaryBits; ++i) secondary[i] = read(mode.secondaryBits - (i == 0));
+
+    auto weight = [&](int bits, int index){ return bits == 2 ? weights2[index] : bits == 3 ? weights3[index] : weights4[index]; };
+
+    for (int i{}; i < 16; ++i){
+        const int (*ends)[4] = endpoints[subset(i)];
+
+        // Modes 4 and 5 index alpha separately, the selection bit swaps the two index sets
+        int colorBits = mode.indexBits, colorIndex = indices[i];
+        int alphaBits = mode.secondaryBits ? mode.secondaryBits : mode.indexBits, alphaIndex = mode.secondaryBits ? secondary[i] : indices[i];
+        if (selection){
+            std::swap(colorBits, alphaBits);
+            std::swap(colorIndex, alphaIndex);
+        }
+
+        for (int c{}; c < 4; ++c){
+            int w = c < 3 ? weight(colorBits, colorIndex) : weight(alphaBits, alphaIndex);
+            out[i * 4 + c] = (unsigned char)(((64 - w) * ends[0][c] + w * ends[1][c] + 32) >> 6);
+        }
+
+        if (rotation) std::swap(out[i * 4 + 3], out[i * 4 + rotation - 1]);
+    }
+}
+
+static bool Decompress(GLenum format, const std::vector<unsigned char>& data, int width, int height, std::vector<unsigned char>& rgba){
+    int blockBytes = BlockBytes(format);
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    rgba.assign((size_t)width * height * 4, 0);
+
+    for (int by{}; by < blocksY; ++by){
+        for (int bx{}; bx < blocksX; ++bx){
+            const unsigned char* block = &data[((size_t)by * blocksX + bx) * blockBytes];
+            unsigned char pixels[64]{};
+
+            switch (format){
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+                DecodeBC1(block, pixels, false, false);
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+                DecodeBC1(block, pixels, true, false);
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+                DecodeBC1(block + 8, pixels, false, true);
+                DecodeBC4(block, pixels, 3);
+                break;
+            case GL_COMPRESSED_RED_RGTC1:
+                DecodeBC4(block, pixels, 0);
+                for (int i{}; i < 16; ++i) pixels[i * 4 + 3] = 255;
+                break;
+            case GL_COMPRESSED_RG_RGTC2:
+                DecodeBC4(block, pixels, 0);
+                DecodeBC4(block + 8, pixels, 1);
+                for (int i{}; i < 16; ++i) pixels[i * 4 + 3] = 255;
+                break;
+            case GL_COMPRESSED_RGB8_ETC2: case GL_COMPRESSED_SRGB8_ETC2:
+                DecodeETC2(block, pixels);
+                break;
+            case GL_COMPRESSED_RGBA8_ETC2_EAC: case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+                DecodeETC2(block + 8, pixels);
+                DecodeEAC(block, pixels);
+                break;
+            case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+                DecodeBC7(block, pixels);
+                break;
+            default:
+                return false;
+            }
+
+            for (int y{}; y < 4 && by * 4 + y < height; ++y){
+                for (int x{}; x < 4 && bx * 4 + x < width; ++x){
+                    std::memcpy(&rgba[(((size_t)by * 4 + y) * width + bx * 4 + x) * 4], &pixels[(y * 4 + x) * 4], 4);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static uint32_t ReadU32(const unsigned char* data){ uint32_t value; std::memcpy(&value, data, 4); return value; }
+static uint64_t ReadU64(const unsigned char* data){ uint64_t value; std::memcpy(&value, data, 8); return value; }
+
+static GLenum FormatFromDXGI(uint32_t format){
+    switch (format){
+    case 71: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case 72: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+    case 77: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case 78: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case 80: return GL_COMPRESSED_RED_RGTC1;
+    case 83: return GL_COMPRESSED_RG_RGTC2;
+    case 98: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case 99: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    }
+
+    return 0;
+}
+
+static GLenum FormatFromVulkan(uint32_t format){
+    switch (format){
+    case 37: return GL_RGBA8;
+    case 43: return GL_SRGB8_ALPHA8;
+    case 131: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case 132: return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    case 133: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case 134: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+    case 137: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case 138: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case 139: return GL_COMPRESSED_RED_RGTC1;
+    case 141: return GL_COMPRESSED_RG_RGTC2;
+    case 145: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case 146: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    case 147: return GL_COMPRESSED_RGB8_ETC2;
+    case 148: return GL_COMPRESSED_SRGB8_ETC2;
+    case 151: return GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case 152: return GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+    }
+
+    return 0;
+}
+
+bool glWrap::Texture2D::IsCompressedFile(const std::string& path){
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return (char)std::tolower(c); });
+    return extension == "dds" || extension == "ktx2";
+}
+
+bool glWrap::Texture2D::ReadCompressed(const std::string& path, Compressed& image){
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    static const unsigned char ktx2[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    // Offsets of every level's first image, both containers store the largest level's size
+    std::vector<uint64_t> offsets;
+
+    if (data.size() >= 128 && std::memcmp(data.data(), "DDS ", 4) == 0){
+        image.size = {(int)ReadU32(&data[16]), (int)ReadU32(&data[12])};
+        if (image.size.x <= 0 || image.size.y <= 0) return false;
+
+        // Writers put anything in the count, the chain can't go past 1x1
+        uint32_t levels = std::min(std::max(ReadU32(&data[28]), 1u), (uint32_t)MipCount(image.size));
+        uint32_t fourCC = ReadU32(&data[84]);
+        uint64_t offset = 128;
+
+        image.format = 0; // Unknown fourCCs leave it unset, a reused image mustn't keep its old one
+        if (fourCC == ReadU32((const unsigned char*)"DXT1")) image.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        else if (fourCC == ReadU32((const unsigned char*)"DXT5")) image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        else if (fourCC == ReadU32((const unsigned char*)"ATI1") || fourCC == ReadU32((const unsigned char*)"BC4U")) image.format = GL_COMPRESSED_RED_RGTC1;
+        else if (fourCC == ReadU32((const unsigned char*)"ATI2") || fourCC == ReadU32((const unsigned char*)"BC5U")) image.format = GL_COMPRESSED_RG_RGTC2;
+        else if (fourCC == ReadU32((const unsigned char*)"DX10") && data.size() >= 148){
+            image.format = FormatFromDXGI(ReadU32(&data[128]));
+            offset = 148;
+        }
+
+        if (!image.format) return false;
+
+        for (uint32_t level{}; level < levels; ++level){
+            offsets.push_back(offset);
+            offset += LevelBytes(image.format, std::max(1, image.size.x >> level), std::max(1, image.size.y >> level));
+        }
+    }
+    else if (data.size() >= 80 && std::memcmp(data.data(), ktx2, 12) == 0){
+        image.format = FormatFromVulkan(ReadU32(&data[12]));
+        image.size = {(int)ReadU32(&data[20]), (int)ReadU32(&data[24])};
+        if (image.size.x <= 0 || image.size.y <= 0) return false;
+
+        uint32_t levels = std::min(std::max(ReadU32(&data[40]), 1u), (uint32_t)MipCount(image.size));
+
+        // Supercompressed data isn't supported
+        if (!image.format || ReadU32(&data[44]) != 0 || data.size() < 80 + (uint64_t)levels * 24) return false;
+
+        for (uint32_t level{}; level < levels; ++level) offsets.push_back(ReadU64(&data[80 + (size_t)level * 24]));
+    }
+    else return false;
+
+    image.levels.clear();
+
+    for (size_t level{}; level < offsets.size(); ++level){
+        int width = std::max(1, image.size.x >> level), height = std::max(1, image.size.y >> level);
+        uint64_t size = LevelBytes(image.format, width, height);
+
+        if (offsets[level] + size > data.size()){
+            DEV_LOG("Truncated texture file: ", path);
+            return false;
+        }
+
+        image.levels.emplace_back(data.begin() + offsets[level], data.begin() + offsets[level] + size);
+        if (width == 1 && height == 1) break;
+    }
+
+    return true;
+}
+
+bool glWrap::Texture2D::WriteCompressed(const std::string& path, const Compressed& image){
+    // Vulkan format, data format descriptor color model and bytes per block of each format that can be written
+    struct Layout{ GLenum format; uint32_t vkFormat; unsigned char model; bool srgb; int bytes; };
+    static const Layout layouts[] = {
+        {GL_RGBA8, 37, 1, false, 4}, {GL_SRGB8_ALPHA8, 43, 1, true, 4},
+        {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 131, 128, false, 8}, {GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 132, 128, true, 8},
+        {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 137, 130, false, 16}, {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 138, 130, true, 16},
+        {GL_COMPRESSED_RGBA_BPTC_UNORM, 145, 134, false, 16}, {GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 146, 134, true, 16}};
+
+    const Layout* layout = std::find_if(std::begin(layouts), std::end(layouts), [&](const Layout& l){ return l.format == image.format; });
+    if (layout == std::end(layouts)) return false;
+
+    std::vector<unsigned char> data;
+    auto put = [&](uint64_t value, int bytes){ for (int i{}; i < bytes; ++i) data.push_back((unsigned char)(value >> (8 * i))); };
+
+    // Samples of the descriptor as {bit offset, bit length, channel}, BC3 keeps alpha in its first half
+    std::vector<std::array<int, 3>> samples;
+    if (layout->model == 1) samples = {{0, 8, 0}, {8, 8, 1}, {16, 8, 2}, {24, 8, 15}};
+    else if (layout->model == 130) samples = {{0, 64, 15}, {64, 64, 0}};
+    else samples = {{0, layout->bytes * 8, 0}};
+
+    uint32_t dfdSize = 4 + 24 + 16 * (uint32_t)samples.size();
+    uint32_t levelCount = (uint32_t)image.levels.size();
+    uint32_t dfdOffset = 80 + 24 * levelCount;
+
+    static const unsigned char identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    data.insert(data.end(), identifier, identifier + 12);
+    put(layout->vkFormat, 4); put(1, 4); put(image.size.x, 4); put(image.size.y, 4);
+    put(0, 4); put(0, 4); put(1, 4); put(levelCount, 4); put(0, 4);
+    put(dfdOffset, 4); put(dfdSize, 4); put(0, 4); put(0, 4); put(0, 8); put(0, 8);
+
+    // Level data follows the descriptor smallest first, aligned to the block size
+    std::vector<uint64_t> offsets(levelCount);
+    uint64_t offset = dfdOffset + dfdSize;
+    for (uint32_t level = levelCount; level-- > 0;){
+        offset = (offset + 15) / 16 * 16;
+        offsets[level] = offset;
+        offset += image.levels[level].size();
+    }
+
+    for (uint32_t level{}; level < levelCount; ++level){
+        put(offsets[level], 8); put(image.levels[level].size(), 8); put(image.levels[level].size(), 8);
+    }
+
+    bool blocks = layout->model != 1;
+    put(dfdSize, 4);
+    put(0, 4);                                                  // Khronos vendor, basic descriptor
+    put(2 | (24 + 16 * samples.size()) << 16, 4);               // Version 1.3 and block size
+    data.push_back(layout->model);
+    data.push_back(1);                                          // BT.709 primaries
+    data.push_back(layout->srgb ? 2 : 1);                       // Transfer function
+    data.push_back(0);                                          // Straight alpha
+    put(blocks ? 0x0303 : 0, 4);                                // Block dimensions minus one
+    put(layout->bytes, 4); put(0, 4);
+
+    for (const std::array<int, 3>& sample : samples){
+        bool linear = layout->srgb && sample[2] == 15;          // Alpha never goes through the transfer function
+        put(sample[0], 2);
+        data.push_back((unsigned char)(sample[1] - 1));
+        data.push_back((unsigned char)(sample[2] | (linear ? 0x10 : 0)));
+        put(0, 4);
+        put(0, 4);
+        put(sample[1] == 8 ? 255 : 0xFFFFFFFF, 4);
+    }
+
+    for (uint32_t level = levelCount; level-- > 0;){
+        data.resize(offsets[level], 0);
+        data.insert(data.end(), image.levels[level].begin(), image.levels[level].end());
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    return (bool)file;
+}
+
+
+static GLenum SizedFormat(GLenum format){ // glTexStorage2D only takes sized formats
+    switch (format){
+    case GL_RED: return GL_R8;
+    case GL_RG: return GL_RG8;
+    case GL_RGB: return GL_RGB8;
+    case GL_RGBA: return GL_RGBA8;
+    case GL_SRGB: return GL_SRGB8;
+    case GL_SRGB_ALPHA: return GL_SRGB8_ALPHA8;
+    }
+
+    return format;
+}
+
+void glWrap::Texture2D::Allocate(GLenum format, glm::ivec2 size, int levels){
+    StateCache& state = StateCache::Current();
+
+    if (m_immutable){
+        state.DeleteTexture(m_ID);
+        m_ID = 0;
+        m_immutable = false;
+    }
+
+    if (!m_ID) glGenTextures(1, &m_ID);
+    state.BindTexture(0, GL_TEXTURE_2D, m_ID);
+    format = SizedFormat(format);
+
+    if (glTexStorage2D){
+        glTexStorage2D(GL_TEXTURE_2D, levels, format, size.x, size.y);
+        m_immutable = true;
+    }
+    else {
+        state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // Null data would read from a bound unpack buffer
+
+        for (int level{}; level < levels; ++level){
+            int width = std::max(1, size.x >> level), height = std::max(1, size.y >> level);
+            if (BlockBytes(format)) glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, (GLsizei)LevelBytes(format, width, height), nullptr);
+            else glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+
+    // Files often stop before the 1x1 level
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+bool glWrap::Texture2D::Upload(const Compressed& image, int firstLevel){
+    int levels = (int)image.levels.size() - firstLevel;
+    Allocate(StorageFormat(image.format), glm::max(image.size >> firstLevel, glm::ivec2(1)), std::max(1, levels));
+
+    for (int level{}; level < levels; ++level){
+        if (!UploadLevel(image, firstLevel + level, firstLevel)) return false;
+    }
+
+    return true;
+}
+
+bool glWrap::Texture2D::UploadLevel(const Compressed& image, int level, int firstLevel){
+    int width = std::max(1, image.size.x >> level), height = std::max(1, image.size.y >> level);
+    const std::vector<unsigned char>& data = image.levels[level];
+    StateCache::Current().BindTexture(0, GL_TEXTURE_2D, m_ID);
+
+    if (!BlockBytes(image.format)){
+        glTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+    }
+    else if (IsFormatSupported(image.format)){
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, 0, width, height, image.format, (GLsizei)data.size(), data.data());
+    }
+    else {
+        std::vector<unsigned char> rgba;
+        if (!Decompress(image.format, data, width, height, rgba)){
+            DEV_LOG("Compressed texture format not supported: ", image.format);
+            return false;
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    }
+
+    return true;
+}
+
+glWrap::Texture2D::Texture2D(std::string image, bool flip, GLenum filter, GLenum desiredChannels){
+    glGenTextures(1, &m_ID);
+    SetSampler({filter, filter});
+
+    if (IsCompressedFile(image)){
+        Compressed compressed;
+        if (ReadCompressed(image, compressed)) Upload(compressed);
+        else std::cout << "Texture not loaded correctly\n";
+        return;
+    }
+
+    stbi_set_flip_vertically_on_load_thread(flip); // Textures may load on the loader thread
+    int width, height, channels;
+    unsigned char *data = stbi_load(image.c_str(), &width, &height, &channels, 0);
+
+    // std::cout << channels << " channels\n";
+
+    if(data)
+    {
+        Allocate(desiredChannels, {width, height}, MipCount({width, height}));
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GetChannelType(channels), GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    else std::cout << "Texture not loaded correctly\n";
+
+    stbi_image_free(data);
+}
+
+glWrap::Texture2D::Texture2D(glm::u8vec4 color, GLenum filter){
+    glGenTextures(1, &m_ID);
+    SetSampler({filter, filter});
+
+    // Left mutable, the loader allocates the real image under the same name
+    StateCache::Current().BindTexture(0, GL_TEXTURE_2D, m_ID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, glm::value_ptr(color));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+glWrap::Texture2D::Texture2D(Texture2D&& other) noexcept
+    : m_samplerState{other.m_samplerState}, m_sampler{other.m_sampler}, m_immutable{other.m_immutable}, m_ID{other.m_ID}{ other.m_ID = 0; }
+
+glWrap::Texture2D& glWrap::Texture2D::operator=(Texture2D&& other) noexcept {
+    if (this != &other){
+        if (m_ID) StateCache::Current().DeleteTexture(m_ID);
+        m_samplerState = other.m_samplerState;
+        m_sampler = other.m_sampler;
+        m_immutable = other.m_immutable;
+        m_ID = other.m_ID;
+        other.m_ID = 0;
+    }
+
+    return *this;
+}
+
+glWrap::Texture2D::~Texture2D(){
+    if (m_ID) StateCache::Current().DeleteTexture(m_ID);
+}
+
+void glWrap::Texture2D::SetSampler(const SamplerState& sampler){
+    m_samplerState = sampler;
+    m_sampler = SamplerCache::Get(sampler);
+}
+
+const glWrap::SamplerState& glWrap::Texture2D::GetSampler() const { return m_samplerState; }
+unsigned int glWrap::Texture2D::GetSamplerID() const { return m_sampler; }
+
+void glWrap::Texture2D::SetActive(unsigned int unit){
+    StateCache::Current().BindTexture(unit, GL_TEXTURE_2D, m_ID);
+    StateCache::Current().BindSampler(unit, m_sampler);
+}
+
+glWrap::Texture2DArray::Texture2DArray(glm::ivec2 size, int layers, GLenum filter, bool mipmaps) : m_size{size}, m_layers{layers} {
+    glGenTextures(1, &m_ID);
+    StateCache& state = StateCache::Current();
+    state.BindTexture(0, GL_TEXTURE_2D_ARRAY, m_ID);
+
+    GLenum minFilter = !mipmaps ? filter : filter == GL_NEAREST ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR;
+    SetSampler({minFilter, filter, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE});
+
+    int levels = mipmaps ? MipCount(size) : 1;
+    if (glTexStorage3D) glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, size.x, size.y, layers);
+    else {
+        state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        for (int level{}; level < levels; ++level){
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(1, size.x >> level), std::max(1, size.y >> level), layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+void glWrap::Texture2DArray::SetLayer(int layer, const unsigned char* pixels, glm::ivec2 size, glm::ivec2 offset){
+    StateCache::Current().BindTexture(0, GL_TEXTURE_2D_ARRAY, m_ID);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, offset.x, offset.y, layer, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+void glWrap::Texture2DArray::GenerateMipmaps(){
+    StateCache::Current().BindTexture(0, GL_TEXTURE_2D_ARRAY, m_ID);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+glm::ivec2 glWrap::Texture2DArray::GetSize() const { return m_size; }
+int glWrap::Texture2DArray::GetLayerCount() const { return m_layers; }
+
+void glWrap::Texture2DArray::SetSampler(const SamplerState& sampler){
+    m_samplerState = sampler;
+    m_sampler = SamplerCache::Get(sampler);
+}
+
+const glWrap::SamplerState& glWrap::Texture2DArray::GetSampler() const { return m_samplerState; }
+unsigned int glWrap::Texture2DArray::GetSamplerID() const { return m_sampler; }
+
+glWrap::Texture2DArray::Texture2DArray(Texture2DArray&& other) noexcept
+    : m_size{other.m_size}, m_layers{other.m_layers}, m_samplerState{other.m_samplerState}, m_sampler{other.m_sampler}, m_ID{other.m_ID}{ other.m_ID = 0; }
+
+glWrap::Texture2DArray& glWrap::Texture2DArray::operator=(Texture2DArray&& other) noexcept {
+    if (this != &other){
+        if (m_ID) StateCache::Current().DeleteTexture(m_ID);
+        m_size = other.m_size;
+        m_layers = other.m_layers;
+        m_samplerState = other.m_samplerState;
+        m_sampler = other.m_sampler;
+        m_ID = other.m_ID;
+        other.m_ID = 0;
+    }
+    return *this;
+}
+
+glWrap::Texture2DArray::~Texture2DArray(){
+    if (m_ID) StateCache::Current().DeleteTexture(m_ID);
+}
+
+void glWrap::Texture2DArray::SetActive(unsigned int unit){
+    StateCache::Current().BindTexture(unit, GL_TEXTURE_2D_ARRAY, m_ID);
+    StateCache::Current().BindSampler(unit, m_sampler);
+}
+
+glWrap::TextureLoader::Request::~Request(){ stbi_image_free(pixels); }
+
+glWrap::TextureLoader::TextureLoader(JobSystem* jobs, size_t frameBudget){
+    m_jobs = jobs ? jobs : &JobSystem::Default();
+    SetFrameBudget(frameBudget);
+}
+
+std::shared_ptr<glWrap::Texture2D> glWrap::TextureLoader::Load(std::string image, bool flip, GLenum filter, GLenum desiredChannels){
+    auto texture = std::make_shared<Texture2D>(m_placeholder, filter);
+    Load(texture, image, flip, desiredChannels);
+    return texture;
+}
+
+void glWrap::TextureLoader::Load(std::shared_ptr<Texture2D> texture, std::string image, bool flip, GLenum desiredChannels){
+    auto request = std::make_shared<Request>();
+    request->texture = texture;
+    request->image = image;
+    request->format = desiredChannels;
+    m_requests.push_back(request);
+
+    // The job keeps the request alive even if the loader drops it
+    m_jobs->RunBackground([request, flip](){
+        if (Texture2D::IsCompressedFile(request->image)){
+            request->state = Texture2D::ReadCompressed(request->image, request->compressed) ? 1 : -1;
+            return;
+        }
+
+        stbi_set_flip_vertically_on_load_thread(flip);
+        request->pixels = stbi_load(request->image.c_str(), &request->width, &request->height, &request->channels, 0);
+        request->state = request->pixels ? 1 : -1;
+    });
+}
+
+void glWrap::TextureLoader::Update(){
+    StateCache& state = StateCache::Current();
+    size_t budget = m_frameBudget;
+
+    for (size_t i{}; i < m_requests.size();){
+        Request& request = *m_requests[i];
+        int status = request.state.load();
+
+        if (status == 0 || (status == 1 && budget == 0)){
+            ++i;
+            continue;
+        }
+
+        if (status == -1){
+            DEV_LOG("Texture not loaded correctly: ", request.image);
+            m_requests.erase(m_requests.begin() + i);
+            continue;
+        }
+
+        // Compressed levels go straight from memory, smallest first and a whole level at a time.
+        // The base level follows them, so only uploaded levels are sampled
+        if (!request.compressed.levels.empty()){
+            const Texture2D::Compressed& chain = request.compressed;
+            state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            if (request.level < 0){
+                request.texture->Allocate(StorageFormat(chain.format), chain.size, (int)chain.levels.size());
+                request.level = (int)chain.levels.size() - 1;
+            }
+
+            while (request.level >= 0 && budget > 0){
+                request.texture->UploadLevel(chain, request.level);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, request.level);
+
+                budget -= std::min(budget, chain.levels[request.level].size());
+                --request.level;
+            }
+
+            if (request.level >= 0) ++i;
+            else m_requests.erase(m_requests.begin() + i);
+            continue;
+        }
+
+        size_t size = (size_t)request.width * request.height * request.channels;
+
+        if (!request.buffer){
+            glGenBuffers(1, &request.buffer);
+            state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, request.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+        else state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, request.buffer);
+
+        // Unsynchronized, no earlier command reads the range written here
+        size_t chunk = std::min(budget, size - request.written);
+        void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, request.written, chunk, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        std::memcpy(target, request.pixels + request.written, chunk);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        request.written += chunk;
+        budget -= chunk;
+
+        if (request.written < size){
+            ++i;
+            continue;
+        }
+
+        // The copy out of the buffer runs on the GPU, the placeholder shows until it's done
+        request.texture->Allocate(request.format, {request.width, request.height}, MipCount({request.width, request.height}));
+        state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, request.buffer);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, request.width, request.height, GetChannelType(request.channels), GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        state.DeleteBuffer(request.buffer);
+        m_requests.erase(m_requests.begin() + i);
+    }
+
+    // Texture uploads elsewhere read client memory
+    state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void glWrap::TextureLoader::Release(){
+    for (auto& request : m_requests){
+        if (request->buffer) StateCache::Current().DeleteBuffer(request->buffer);
+    }
+
+    m_requests.clear();
+}
+
+void glWrap::TextureLoader::SetFrameBudget(size_t bytes){ m_frameBudget = std::max(bytes, (size_t)1); }
+void glWrap::TextureLoader::SetPlaceholderColor(glm::u8vec4 color){ m_placeholder = color; }
+glm::u8vec4 glWrap::TextureLoader::GetPlaceholderColor(){ return m_placeholder; }
+void glWrap::TextureLoader::SetJobSystem(JobSystem& jobs){ m_jobs = &jobs; }
+size_t glWrap::TextureLoader::GetPending(){ return m_requests.size(); }
+
+bool glWrap::TextureLoader::IsReady(const Texture2D* texture){
+    for (auto& request : m_requests){
+        if (request->texture.get() == texture) return false;
+    }
+
+    return true;
+}
+
+std::shared_ptr<glWrap::Texture2D> glWrap::TextureCache::Share(Texture2D* texture){
+    std::shared_ptr<Released> released = m_released;
+
+    // The name outlives the object, the deleting thread may not have the context
+    return std::shared_ptr<Texture2D>(texture, [released](Texture2D* texture){
+        {
+            std::lock_guard<std::mutex> lock(released->mutex);
+            released->textures.push_back(texture->m_ID);
+        }
+
+        texture->m_ID = 0;
+        delete texture;
+    });
+}
+
+std::shared_ptr<glWrap::Texture2D> glWrap::TextureCache::Get(std::string image, bool flip, GLenum filter, GLenum desiredChannels, TextureLoader* loader){
+    std::weak_ptr<Texture2D>& entry = m_entries[Key{image, flip, filter, desiredChannels}];
+    if (std::shared_ptr<Texture2D> texture = entry.lock()) return texture;
+
+    std::shared_ptr<Texture2D> texture;
+    if (loader){
+        texture = Share(new Texture2D(loader->GetPlaceholderColor(), filter));
+        loader->Load(texture, image, flip, desiredChannels);
+    }
+    else texture = Share(new Texture2D(image, flip, filter, desiredChannels));
+
+    entry = texture;
+    return texture;
+}
+
+void glWrap::TextureCache::Collect(){
+    DeleteReleased();
+
+    for (auto it = m_entries.begin(); it != m_entries.end();){
+        if (it->second.expired()) it = m_entries.erase(it);
+        else ++it;
+    }
+}
+
+void glWrap::TextureCache::DeleteReleased(){
+    std::vector<GLuint> textures;
+    {
+        std::lock_guard<std::mutex> lock(m_released->mutex);
+        textures.swap(m_released->textures);
+    }
+
+    for (GLuint texture : textures) StateCache::Current().DeleteTexture(texture);
+}
+
+size_t glWrap::TextureCache::Size(){
+    size_t used{};
+    for (auto& entry : m_entries) used += !entry.second.expired();
+    return used;
+}
+
+glWrap::TextureAtlas::TextureAtlas(glm::ivec2 layerSize, int padding) : m_size{layerSize}, m_padding{padding} {}
+
+bool glWrap::TextureAtlas::Add(const std::string& name, const std::string& image, bool flip){
+    stbi_set_flip_vertically_on_load_thread(flip);
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(image.c_str(), &width, &height, &channels, 4);
+
+    if (!pixels){
+        DEV_LOG("Failed to load image: ", image);
+        return false;
+    }
+
+    bool added = Add(name, pixels, {width, height});
+    stbi_image_free(pixels);
+    return added;
+}
+
+bool glWrap::TextureAtlas::Add(const std::string& name, const unsigned char* pixels, glm::ivec2 size){
+    if (size.x <= 0 || size.y <= 0 || size.x + 2 * m_padding > m_size.x || size.y + 2 * m_padding > m_size.y){
+        DEV_LOG("Image doesn't fit an atlas layer: ", name);
+        return false;
+    }
+
+    auto image = std::find_if(m_images.begin(), m_images.end(), [&](const Image& i){ return i.name == name; });
+    if (image == m_images.end()) image = m_images.insert(m_images.end(), Image{name});
+
+    image->pixels.assign(pixels, pixels + (size_t)size.x * size.y * 4);
+    image->size = size;
+    return true;
+}
+
+// Top edge of the packed area as segments left to right
+struct SkylineNode{
+    int x, y, width;
+};
+
+// Lowest spot the rectangle fits on, ties going to the narrowest segment
+static bool PlaceOnSkyline(std::vector<SkylineNode>& skyline, glm::ivec2 bounds, glm::ivec2 size, glm::ivec2& corner){
+    size_t best{skyline.size()};
+    int bestTop{std::numeric_limits<int>::max()}, bestWidth{std::numeric_limits<int>::max()};
+
+    for (size_t i{}; i < skyline.size(); ++i){
+        if (skyline[i].x + size.x > bounds.x) break;
+
+        // Rests on the highest segment under its width
+        int y{}, remaining{size.x};
+        for (size_t j = i; remaining > 0; ++j){
+            y = std::max(y, skyline[j].y);
+            remaining -= skyline[j].width;
+        }
+
+        if (y + size.y > bounds.y) continue;
+
+        if (y + size.y < bestTop || (y + size.y == bestTop && skyline[i].width < bestWidth)){
+            best = i;
+            bestTop = y + size.y;
+            bestWidth = skyline[i].width;
+            corner = {skyline[i].x, y};
+        }
+    }
+
+    if (best == skyline.size()) return false;
+
+    skyline.insert(skyline.begin() + best, {corner.x, corner.y + size.y, size.x});
+
+    // Segments now under the rectangle shrink or go
+    for (size_t i = best + 1; i < skyline.size();){
+        int covered = corner.x + size.x - skyline[i].x;
+        if (covered <= 0) break;
+
+        if (covered >= skyline[i].width){
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+
+        skyline[i].x += covered;
+        skyline[i].width -= covered;
+        break;
+    }
+
+    for (size_t i{}; i + 1 < skyline.size();){
+        if (skyline[i].y == skyline[i + 1].y){
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else ++i;
+    }
+
+    return true;
+}
+
+void glWrap::TextureAtlas::Build(GLenum filter, bool mipmaps){
+    // Tallest first keeps the skyline flat
+    std::vector<size_t> order(m_images.size());
+    for (size_t i{}; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+        return m_images[a].size.y != m_images[b].size.y ? m_images[a].size.y > m_images[b].size.y : m_images[a].size.x > m_images[b].size.x;
+    });
+
+    std::vector<std::vector<SkylineNode>> skylines;
+    std::vector<std::pair<size_t, glm::ivec2>> places(m_images.size()); // Layer and padded corner
+
+    for (size_t i : order){
+        glm::ivec2 size = m_images[i].size + 2 * m_padding;
+        glm::ivec2 corner{};
+        size_t layer{};
+
+        while (layer < skylines.size() && !PlaceOnSkyline(skylines[layer], m_size, size, corner)) ++layer;
+
+        if (layer == skylines.size()){
+            skylines.push_back({{0, 0, m_size.x}});
+            PlaceOnSkyline(skylines.back(), m_size, size, corner);
+        }
+
+        places[i] = {layer, corner};
+    }
+
+    m_entries.clear();
+    m_texture = std::make_unique<Texture2DArray>(m_size, std::max<int>(1, (int)skylines.size()), filter, mipmaps);
+
+    // Layers are composed in memory and sent whole, the padding repeating each image's edge
+    std::vector<unsigned char> layerPixels;
+
+    for (size_t layer{}; layer < skylines.size(); ++layer){
+        layerPixels.assign((size_t)m_size.x * m_size.y * 4, 0);
+
+        for (size_t i{}; i < m_images.size(); ++i){
+            if (places[i].first != layer) continue;
+
+            const Image& image = m_images[i];
+            glm::ivec2 origin = places[i].second + m_padding;
+
+            for (int y = -m_padding; y < image.size.y + m_padding; ++y){
+                int sourceY = std::min(std::max(y, 0), image.size.y - 1);
+
+                for (int x = -m_padding; x < image.size.x + m_padding; ++x){
+                    int sourceX = std::min(std::max(x, 0), image.size.x - 1);
+                    std::memcpy(&layerPixels[((size_t)(origin.y + y) * m_size.x + origin.x + x) * 4], &image.pixels[((size_t)sourceY * image.size.x + sourceX) * 4], 4);
+                }
+            }
+
+            Entry& entry = m_entries[image.name];
+            entry.layer = layer;
+            entry.rect = {origin, image.size};
+            entry.uv = glm::vec4(origin, origin + image.size) / glm::vec4(m_size, m_size);
+        }
+
+        m_texture->SetLayer(layer, layerPixels.data(), m_size);
+    }
+
+    if (mipmaps) m_texture->GenerateMipmaps();
+}
+
+const glWrap::TextureAtlas::Entry* glWrap::TextureAtlas::Get(const std::string& name) const {
+    auto entry = m_entries.find(name);
+    return entry == m_entries.end() ? nullptr : &entry->second;
+}
+
+glWrap::Texture2DArray* glWrap::TextureAtlas::GetTexture(){ return m_texture.get(); }
+size_t glWrap::TextureAtlas::Size() const { return m_entries.size(); }
+
+// 
+// *TEXTURE COOKER
+// 
+
+glWrap::TextureCooker::TextureCooker(JobSystem& jobs) : m_jobs{&jobs} {}
+
+// Source pixels and weights making up one destination pixel of a resampled row or column
+struct FilterTaps{
+    int                 first;
+    std::vector<float>  weights;
+};
+
+static std::vector<FilterTaps> FilterWeights(int source, int destination, glWrap::TextureCooker::Filter filter){
+    auto bessel = [](float x){ // Zeroth order, modified
+        float sum{1.0f}, term{1.0f};
+        for (int k{1}; k < 16; ++k){ term *= (x / (2 * k)) * (x / (2 * k)); sum += term; }
+        return sum;
+    };
+
+    const float width = 3.0f, alpha = 4.0f; // Kaiser window three destination pixels each side
+    float scale = (float)source / destination;
+    std::vector<FilterTaps> taps(destination);
+
+    for (int x{}; x < destination; ++x){
+        float center = (x + 0.5f) * scale;
+        float radius = filter == glWrap::TextureCooker::Filter::Box ? scale * 0.5f : scale * width;
+        taps[x].first = (int)std::floor(center - radius);
+        int last = (int)std::ceil(center + radius);
+        float total{};
+
+        for (int j = taps[x].first; j < last; ++j){
+            float weight;
+
+            if (filter == glWrap::TextureCooker::Filter::Box){ // Coverage of the source pixel
+                weight = std::max(0.0f, std::min(j + 1.0f, center + radius) - std::max((float)j, center - radius));
+            }
+            else {
+                float t = (j + 0.5f - center) / scale;
+                float window = std::abs(t) < width ? bessel(alpha * std::sqrt(1.0f - (t / width) * (t / width))) / bessel(alpha) : 0.0f;
+                weight = (t == 0.0f ? 1.0f : std::sin(glm::pi<float>() * t) / (glm::pi<float>() * t)) * window;
+            }
+
+            taps[x].weights.push_back(weight);
+            total += weight;
+        }
+
+        for (float& weight : taps[x].weights) weight /= total;
+    }
+
+    return taps;
+}
+
+// Weighted sum of RGBA pixels stride floats apart, clamping at the edges
+static void FilterPixel(const float* source, size_t stride, int size, const FilterTaps& taps, float* out){
+#if defined(GW_SIMD_AVX) || defined(GW_SIMD_SSE)
+    __m128 sum = _mm_setzero_ps();
+
+    for (int i{}; i < taps.weights.size(); ++i){
+        int j = std::min(std::max(taps.first + i, 0), size - 1);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weights[i]), _mm_loadu_ps(source + j * stride)));
+    }
+
+    _mm_storeu_ps(out, sum);
+#else
+    float sum[4]{};
+
+    for (int i{}; i < taps.weights.size(); ++i){
+        int j = std::min(std::max(taps.first + i, 0), size - 1);
+        for (int c{}; c < 4; ++c) sum[c] += taps.weights[i] * source[j * stride + c];
+    }
+
+    std::copy(sum, sum + 4, out);
+#endif
+}
+
+std::vector<std::vector<unsigned char>> glWrap::TextureCooker::GenerateMips(const unsigned char* pixels, glm::ivec2 size, Filter filter, bool srgb){
+    float toLinear[256];
+    for (int i{}; i < 256; ++i){
+        float c = i / 255.0f;
+        toLinear[i] = srgb ? (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f)) : c;
+    }
+
+    // Every level filters the one before in linear floats, only the output is quantized
+    std::vector<float> level((size_t)size.x * size.y * 4), rows, next;
+    for (size_t i{}; i < level.size(); ++i) level[i] = (i & 3) == 3 ? pixels[i] / 255.0f : toLinear[pixels[i]];
+
+    std::vector<std::vector<unsigned char>> levels(1, std::vector<unsigned char>(pixels, pixels + level.size()));
+
+    while (size.x > 1 || size.y > 1){
+        glm::ivec2 half = glm::max(size / 2, glm::ivec2(1));
+        std::vector<FilterTaps> horizontal = FilterWeights(size.x, half.x, filter), vertical = FilterWeights(size.y, half.y, filter);
+
+        rows.resize((size_t)half.x * size.y * 4);
+        next.resize((size_t)half.x * half.y * 4);
+        std::vector<unsigned char> bytes(next.size());
+
+        m_jobs->ParallelFor(size.y, 16, [&](size_t begin, size_t end){
+            for (size_t y = begin; y < end; ++y){
+                for (int x{}; x < half.x; ++x) FilterPixel(&level[y * size.x * 4], 4, size.x, horizontal[x], &rows[(y * half.x + x) * 4]);
+            }
+        });
+
+        m_jobs->ParallelFor(half.y, 16, [&](size_t begin, size_t end){
+            for (size_t y = begin; y < end; ++y){
+                for (int x{}; x < half.x; ++x){
+                    size_t i = (y * half.x + x) * 4;
+                    FilterPixel(&rows[x * 4], (size_t)half.x * 4, size.y, vertical[y], &next[i]);
+
+                    // Kaiser lobes ring past the range
+                    for (int c{}; c < 4; ++c){
+                        float value = glm::clamp(next[i + c], 0.0f, 1.0f);
+                        next[i + c] = value;
+                        if (srgb && c < 3) value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                        bytes[i + c] = (unsigned char)(value * 255.0f + 0.5f);
+                    }
+                }
+            }
+        });
+
+        levels.push_back(std::move(bytes));
+        level.swap(next);
+        size = half;
+    }
+
+    return levels;
+}
+
+// Ends of the line through the block's principal axis covering its pixels, in the channels of the mask
+static void FitEndpoints(const glm::vec4* pixels, glm::vec4 mask, glm::vec4& low, glm::vec4& high){
+    glm::vec4 mean{}, minimum{255.0f}, maximum{0.0f};
+    for (int i{}; i < 16; ++i){ mean += pixels[i]; minimum = glm::min(minimum, pixels[i]); maximum = glm::max(maximum, pixels[i]); }
+    mean *= mask / 16.0f;
+
+    glm::mat4 covariance{0.0f};
+    for (int i{}; i < 16; ++i){
+        glm::vec4 d = pixels[i] * mask - mean;
+        covariance += glm::outerProduct(d, d);
+    }
+
+    glm::vec4 axis = (maximum - minimum) * mask;
+    for (int iteration{}; iteration < 8 && glm::dot(axis, axis) > 1e-6f; ++iteration){
+        axis = covariance * axis;
+        axis /= std::max(std::abs(axis.x), std::max(std::abs(axis.y), std::max(std::abs(axis.z), std::abs(axis.w))));
+    }
+
+    if (glm::dot(axis, axis) <= 1e-6f){ low = high = mean; return; }
+    axis = glm::normalize(axis);
+
+    float lowest{std::numeric_limits<float>::max()}, highest{std::numeric_limits<float>::lowest()};
+    for (int i{}; i < 16; ++i){
+        float t = glm::dot(pixels[i] * mask - mean, axis);
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+
+    // Pull the ends in a little, extremes rarely sit exactly on the palette
+    float inset = (highest - lowest) / 32.0f;
+    low = glm::clamp(mean + axis * (lowest + inset), 0.0f, 255.0f);
+    high = glm::clamp(mean + axis * (highest - inset), 0.0f, 255.0f);
+}
+
+static int NearestIndex(const glm::vec4* palette, int count, glm::vec4 pixel, glm::vec4 mask){
+    int best{};
+    float bestDistance{std::numeric_limits<float>::max()};
+
+    for (int i{}; i < count; ++i){
+        glm::vec4 d = (palette[i] - pixel) * mask;
+        float distance = glm::dot(d, d);
+        if (distance < bestDistance){ bestDistance = distance; best = i; }
+    }
+
+    return best;
+}
+
+static void EncodeBC1(const glm::vec4* pixels, unsigned char* block){
+    glm::vec4 low, high;
+    FitEndpoints(pixels, {1.0f, 1.0f, 1.0f, 0.0f}, low, high);
+
+    auto to565 = [](glm::vec4 c){ return (unsigned int)(c.r * 31.0f / 255.0f + 0.5f) << 11 | (unsigned int)(c.g * 63.0f / 255.0f + 0.5f) << 5 | (unsigned int)(c.b * 31.0f / 255.0f + 0.5f); };
+    unsigned int c0 = to565(high), c1 = to565(low);
+    if (c0 < c1) std::swap(c0, c1);
+
+    // Same palette the decoder builds, four colors as c0 > c1
+    unsigned char decoded[64];
+    unsigned char endpoints[8] = {(unsigned char)c0, (unsigned char)(c0 >> 8), (unsigned char)c1, (unsigned char)(c1 >> 8), 0xE4, 0, 0, 0}; // Indices 0 1 2 3
+    DecodeBC1(endpoints, decoded, false, true);
+
+    glm::vec4 palette[4];
+    for (int i{}; i < 4; ++i) palette[i] = {decoded[i * 4], decoded[i * 4 + 1], decoded[i * 4 + 2], 0.0f};
+
+    unsigned int indices{};
+    if (c0 != c1){ // Equal ends leave every pixel on c0
+        for (int i{}; i < 16; ++i) indices |= (unsigned int)NearestIndex(palette, 4, pixels[i], {1.0f, 1.0f, 1.0f, 0.0f}) << (2 * i);
+    }
+
+    unsigned int words[2] = {c0 | c1 << 16, indices};
+    for (int i{}; i < 8; ++i) block[i] = (unsigned char)(words[i / 4] >> (8 * (i & 3)));
+}
+
+static void EncodeAlpha(const glm::vec4* pixels, unsigned char* block){
+    float lowest{255.0f}, highest{0.0f};
+    for (int i{}; i < 16; ++i){ lowest = std::min(lowest, pixels[i].a); highest = std::max(highest, pixels[i].a); }
+
+    int a0 = (int)(highest + 0.5f), a1 = (int)(lowest + 0.5f);
+    block[0] = (unsigned char)a0;
+    block[1] = (unsigned char)a1;
+
+    glm::vec4 palette[8];
+    for (int i{}; i < 8; ++i){
+        int value = i < 2 ? (i ? a1 : a0) : ((8 - i) * a0 + (i - 1) * a1) / 7;
+        palette[i] = {0.0f, 0.0f, 0.0f, (float)value};
+    }
+
+    uint64_t indices{};
+    if (a0 != a1){
+        for (int i{}; i < 16; ++i) indices |= (uint64_t)NearestIndex(palette, 8, pixels[i], {0.0f, 0.0f, 0.0f, 1.0f}) << (3 * i);
+    }
+
+    for (int i{}; i < 6; ++i) block[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// Ends whose line best fits the pixels in the least squares sense, each pixel sitting at its weight along it
+static bool RefineEndpoints(const glm::vec4* pixels, const float* weights, glm::vec4& low, glm::vec4& high){
+    float a{}, b{}, c{};
+    glm::vec4 x{}, y{};
+
+    for (int i{}; i < 16; ++i){
+        float w = weights[i];
+        a += (1.0f - w) * (1.0f - w); b += w * (1.0f - w); c += w * w;
+        x += (1.0f - w) * pixels[i]; y += w * pixels[i];
+    }
+
+    float determinant = a * c - b * b;
+    if (std::abs(determinant) < 1e-6f) return false;
+
+    low = glm::clamp((c * x - b * y) / determinant, 0.0f, 255.0f);
+    high = glm::clamp((a * y - b * x) / determinant, 0.0f, 255.0f);
+    return true;
+}
+
+// BC7 mode 6 only, one RGBA line with 7 bit ends and a p bit each, sixteen steps between them
+static void EncodeBC7(const glm::vec4* pixels, unsigned char* block){
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+    const glm::vec4 all{1.0f};
+
+    glm::ivec4 quantized[2]{};
+    int pbits[2]{}, indices[16]{};
+    float bestError{std::numeric_limits<float>::max()};
+
+    glm::vec4 ends[2];
+    FitEndpoints(pixels, all, ends[0], ends[1]);
+
+    // The principal axis, then the least squares line through the indices it picked
+    for (int pass{}; pass < 2; ++pass){
+        glm::ivec4 q[2];
+        int p[2], candidate[16];
+
+        for (int e{}; e < 2; ++e){ // The p bit landing closer for all four channels
+            float endError{std::numeric_limits<float>::max()};
+
+            for (int bit{}; bit < 2; ++bit){
+                glm::ivec4 value = glm::clamp(glm::ivec4((ends[e] - (float)bit) / 2.0f + 0.5f), 0, 127);
+                glm::vec4 d = glm::vec4(value * 2 + bit) - ends[e];
+                if (glm::dot(d, d) < endError){ endError = glm::dot(d, d); q[e] = value; p[e] = bit; }
+            }
+        }
+
+        glm::ivec4 e0 = q[0] * 2 + p[0], e1 = q[1] * 2 + p[1];
+        glm::vec4 palette[16];
+        for (int i{}; i < 16; ++i) palette[i] = glm::vec4(((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6);
+
+        float error{};
+        float fractions[16];
+
+        for (int i{}; i < 16; ++i){
+            candidate[i] = NearestIndex(palette, 16, pixels[i], all);
+            glm::vec4 d = palette[candidate[i]] - pixels[i];
+            error += glm::dot(d, d);
+            fractions[i] = weights[candidate[i]] / 64.0f;
+        }
+
+        if (error < bestError){
+            bestError = error;
+            std::copy(q, q + 2, quantized);
+            std::copy(p, p + 2, pbits);
+            std::copy(candidate, candidate + 16, indices);
+        }
+
+        if (!RefineEndpoints(pixels, fractions, ends[0], ends[1])) break;
+    }
+
+    // The first index is stored without its top bit, swapping the ends clears it
+    if (indices[0] & 8){
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pbits[0], pbits[1]);
+        for (int& index : indices) index = 15 - index;
+    }
+
+    uint64_t bits[2]{};
+    int position{};
+    auto put = [&](unsigned int value, int count){
+        for (int b{}; b < count; ++b, ++position) bits[position / 64] |= (uint64_t)(value >> b & 1) << (position % 64);
+    };
+
+    put(1 << 6, 7);
+    for (int c{}; c < 4; ++c){ put(quantized[0][c], 7); put(quantized[1][c], 7); }
+    put(pbits[0], 1);
+    put(pbits[1], 1);
+    put(indices[0], 3);
+    for (int i{1}; i < 16; ++i) put(indices[i], 4);
+
+    for (int i{}; i < 16; ++i) block[i] = (unsigned char)(bits[i / 8] >> (8 * (i & 7)));
+}
+
+glWrap::Texture2D::Compressed glWrap::TextureCooker::Encode(const std::vector<std::vector<unsigned char>>& levels, glm::ivec2 size, Encoding encoding, bool srgb){
+    Texture2D::Compressed image;
+    image.size = size;
+
+    switch (encoding){
+    case Encoding::RGBA8: image.format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; break;
+    case Encoding::BC1: image.format = srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+    case Encoding::BC3: image.format = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+    case Encoding::BC7: image.format = srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+    }
+
+    if (encoding == Encoding::RGBA8){
+        image.levels = levels;
+        return image;
+    }
+
+    // Block rows of all levels share one parallel loop, small levels would leave threads idle
+    int blockBytes = BlockBytes(image.format);
+    std::vector<std::pair<int, int>> rows;
+
+    for (int level{}; level < levels.size(); ++level){
+        glm::ivec2 extent = glm::max(size >> level, glm::ivec2(1));
+        image.levels.emplace_back(LevelBytes(image.format, extent.x, extent.y));
+        for (int row{}; row < (extent.y + 3) / 4; ++row) rows.emplace_back(level, row);
+    }
+
+    m_jobs->ParallelFor(rows.size(), 4, [&](size_t begin, size_t end){
+        for (size_t r = begin; r < end; ++r){
+            int level = rows[r].first, by = rows[r].second;
+            glm::ivec2 extent = glm::max(size >> level, glm::ivec2(1));
+            const std::vector<unsigned char>& source = levels[level];
+
+            for (int bx{}; bx < (extent.x + 3) / 4; ++bx){
+                glm::vec4 pixels[16];
+
+                for (int i{}; i < 16; ++i){ // Edge blocks repeat the last row and column
+                    int x = std::min(bx * 4 + (i & 3), extent.x - 1), y = std::min(by * 4 + i / 4, extent.y - 1);
+                    const unsigned char* p = &source[((size_t)y * extent.x + x) * 4];
+                    pixels[i] = {p[0], p[1], p[2], p[3]};
+                }
+
+                unsigned char* block = &image.levels[level][((size_t)by * ((extent.x + 3) / 4) + bx) * blockBytes];
+
+                if (encoding == Encoding::BC1) EncodeBC1(pixels, block);
+                else if (encoding == Encoding::BC3){ EncodeAlpha(pixels, block); EncodeBC1(pixels, block + 8); }
+                else EncodeBC7(pixels, block);
+            }
+        }
+    });
+
+    return image;
+}
+
+bool glWrap::TextureCooker::Cook(const std::string& image, const std::string& output, const Settings& settings){
+    stbi_set_flip_vertically_on_load_thread(settings.flip);
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(image.c_str(), &width, &height, &channels, 4);
+
+    if (!pixels){
+        DEV_LOG("Failed to load image: ", image);
+        return false;
+    }
+
+    std::vector<std::vector<unsigned char>> levels = GenerateMips(pixels, {width, height}, settings.filter, settings.srgb);
+    stbi_image_free(pixels);
+
+    if (!Texture2D::WriteCompressed(output, Encode(levels, {width, height}, settings.encoding, settings.srgb))){
+        DEV_LOG("Failed to write texture: ", output);
+        return false;
+    }
+
+    return true;
+}
+
+size_t glWrap::TextureCooker::Cook(const std::vector<std::pair<std::string, std::string>>& files, const Settings& settings){
+    std::atomic<size_t> cooked{};
+    JobCounter counter;
+
+    for (const std::pair<std::string, std::string>& file : files){
+        m_jobs->Run([this, &cooked, &file, &settings](){ cooked += Cook(file.first, file.second, settings); }, &counter);
+    }
+
+    m_jobs->Wait(counter);
+    return cooked;
+}
+
+// 
+// *TEXTURE STREAMER
+// 
+
+// Bytes the levels from firstLevel on take on the GPU, blocks decoded on the CPU are stored as RGBA8
+static size_t ResidentBytes(const glWrap::Texture2D::Compressed& chain, int firstLevel){
+    bool decoded = BlockBytes(chain.format) && !IsFormatSupported(chain.format);
+    size_t bytes{};
+
+    for (int level = firstLevel; level < chain.levels.size(); ++level){
+        bytes += decoded ? (size_t)std::max(1, chain.size.x >> level) * std::max(1, chain.size.y >> level) * 4 : chain.levels[level].size();
+    }
+
+    return bytes;
+}
+
+// Coarsest level still at least pixels wide, so it isn't magnified on screen
+static int RequiredLevel(const glWrap::Texture2D::Compressed& chain, float pixels){
+    int edge = std::max(chain.size.x, chain.size.y);
+    int level{};
+
+    while (level + 1 < chain.levels.size() && (edge >> (level + 1)) >= pixels) ++level;
+    return level;
+}
+
+glWrap::TextureStreamer::TextureStreamer(JobSystem* jobs, size_t budget, size_t frameBudget){
+    m_jobs = jobs ? jobs : &JobSystem::Default();
+    SetBudget(budget);
+    SetFrameBudget(frameBudget);
+}
+
+std::shared_ptr<glWrap::Texture2D> glWrap::TextureStreamer::Load(std::string image, bool flip, GLenum filter, bool srgb){
+    auto entry = std::make_shared<Entry>();
+    entry->texture = std::make_shared<Texture2D>(glm::u8vec4{255, 0, 255, 255}, filter);
+    entry->texture->SetSampler({filter == GL_NEAREST ? (GLenum)GL_NEAREST_MIPMAP_NEAREST : (GLenum)GL_LINEAR_MIPMAP_LINEAR, filter});
+    entry->image = image;
+    m_entries.push_back(entry);
+    m_index[entry->texture.get()] = entry.get();
+
+    // Captured like the requests of TextureLoader::Load
+    JobSystem* jobs = m_jobs;
+    m_jobs->RunBackground([entry, flip, srgb, jobs](){
+        if (Texture2D::IsCompressedFile(entry->image)){
+            entry->state = Texture2D::ReadCompressed(entry->image, entry->chain) ? 1 : -1;
+            return;
+        }
+
+        stbi_set_flip_vertically_on_load_thread(flip);
+        int width, height, channels;
+        unsigned char* pixels = stbi_load(entry->image.c_str(), &width, &height, &channels, 4);
+
+        if (!pixels){
+            entry->state = -1;
+            return;
+        }
+
+        entry->chain.format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        entry->chain.size = {width, height};
+        entry->chain.levels = TextureCooker(*jobs).GenerateMips(pixels, {width, height}, TextureCooker::Filter::Box, srgb);
+        stbi_image_free(pixels);
+        entry->state = 1;
+    });
+
+    return entry->texture;
+}
+
+void glWrap::TextureStreamer::Require(const Texture2D* texture, float pixels){
+    auto entry = m_index.find(texture);
+    if (entry != m_index.end()) entry->second->pixels = std::max(entry->second->pixels, pixels);
+}
+
+void glWrap::TextureStreamer::SetResident(Entry& entry, int level){
+    if (entry.resident >= 0) m_residentBytes -= ResidentBytes(entry.chain, entry.resident);
+
+    // Immutable storage can't lose levels, the texture is specified again from the kept copy
+    entry.texture->Upload(entry.chain, level);
+    entry.resident = level;
+    m_residentBytes += ResidentBytes(entry.chain, level);
+}
+
+bool glWrap::TextureStreamer::MakeRoom(size_t bytes, const Entry* keep){
+    while (m_residentBytes + bytes > m_budget){
+        // Least recently needed texture holding finer levels than it needs
+        Entry* victim{nullptr};
+        for (auto& entry : m_entries){
+            if (entry.get() == keep || entry->resident < 0 || entry->resident >= entry->wanted) continue;
+            if (!victim || entry->lastUsed < victim->lastUsed) victim = entry.get();
+        }
+
+        if (!victim) return false;
+
+        size_t over = m_residentBytes + bytes - m_budget;
+        size_t held = ResidentBytes(victim->chain, victim->resident);
+        int level = victim->resident + 1;
+
+        while (level < victim->wanted && held - ResidentBytes(victim->chain, level) < over) ++level;
+        SetResident(*victim, level);
+    }
+
+    return true;
+}
+
+void glWrap::TextureStreamer::Update(){
+    ++m_frame;
+    size_t budget = m_frameBudget;
+    std::vector<std::pair<float, Entry*>> promote;
+
+    for (size_t i{}; i < m_entries.size();){
+        Entry& entry = *m_entries[i];
+        int status = entry.state.load();
+
+        if (status == -1) DEV_LOG("Texture not loaded correctly: ", entry.image);
+
+        // Failed, or no longer drawn by anyone
+        if (status == -1 || entry.texture.use_count() == 1){
+            if (entry.resident >= 0) m_residentBytes -= ResidentBytes(entry.chain, entry.resident);
+            m_index.erase(entry.texture.get());
+            m_entries.erase(m_entries.begin() + i);
+            continue;
+        }
+
+        ++i;
+        if (status == 0) continue;
+
+        int last = (int)entry.chain.levels.size() - 1;
+
+        if (entry.resident < 0){
+            int level{};
+            while (level < last && (std::max(entry.chain.size.x, entry.chain.size.y) >> level) > m_initialSize) ++level;
+
+            if (!entry.texture->Upload(entry.chain, level)){
+                entry.state = -1;
+                continue;
+            }
+
+            entry.resident = level;
+            entry.wanted = last;
+            m_residentBytes += ResidentBytes(entry.chain, level);
+            budget -= std::min(budget, ResidentBytes(entry.chain, level));
+        }
+
+        // Textures not drawn since the last call may lose every level but the smallest
+        if (entry.pixels > 0.0f){
+            entry.wanted = RequiredLevel(entry.chain, entry.pixels);
+            entry.lastUsed = m_frame;
+            if (entry.wanted < entry.resident) promote.push_back({entry.pixels, &entry});
+        }
+        else entry.wanted = last;
+
+        entry.pixels = 0.0f;
+    }
+
+    // Largest on screen first
+    std::sort(promote.begin(), promote.end(), [](const std::pair<float, Entry*>& a, const std::pair<float, Entry*>& b){ return a.first > b.first; });
+
+    for (auto& candidate : promote){
+        Entry* entry = candidate.second;
+        size_t held = ResidentBytes(entry->chain, entry->resident);
+        int level = entry->wanted;
+
+        // Finer levels wait for later calls, one step always fits into an unused budget
+        while (level < entry->resident && ResidentBytes(entry->chain, level) > budget && !(budget == m_frameBudget && level == entry->resident - 1)) ++level;
+
+        // Coarser still when not enough other levels can be evicted
+        while (level < entry->resident && !MakeRoom(ResidentBytes(entry->chain, level) - held, entry)) ++level;
+
+        if (level == entry->resident) continue;
+
+        SetResident(*entry, level);
+        budget -= std::min(budget, ResidentBytes(entry->chain, level));
+    }
+
+    // The budget may have been lowered
+    MakeRoom(0, nullptr);
+}
+
+void glWrap::TextureStreamer::Release(){
+    m_entries.clear();
+    m_index.clear();
+    m_residentBytes = 0;
+}
+
+void glWrap::TextureStreamer::SetBudget(size_t bytes){ m_budget = bytes; }
+void glWrap::TextureStreamer::SetFrameBudget(size_t bytes){ m_frameBudget = std::max(bytes, (size_t)1); }
+void glWrap::TextureStreamer::SetInitialSize(int pixels){ m_initialSize = std::max(pixels, 1); }
+void glWrap::TextureStreamer::SetJobSystem(JobSystem& jobs){ m_jobs = &jobs; }
+size_t glWrap::TextureStreamer::GetResidentBytes(){ return m_residentBytes; }
+size_t glWrap::TextureStreamer::Size(){ return m_entries.size(); }
+
+int glWrap::TextureStreamer::GetResidentLevel(const Texture2D* texture){
+    auto entry = m_index.find(texture);
+    return entry != m_index.end() ? entry->second->resident : -1;
+}
+
+// 
+// *PROGRAM CACHE
+// 
+
+static std::mutex programCacheMutex;
+static std::string programCacheDirectory;
+static std::atomic<unsigned int> programCacheHits{}, programCacheMisses{};
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size){ // FNV-1a
+    for (size_t i{}; i < size; ++i) hash = (hash ^ ((const unsigned char*)data)[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+static uint64_t HashString(uint64_t hash, const char* text){
+    return HashBytes(hash, text, std::strlen(text) + 1); // The terminator separates consecutive strings
+}
+
+static bool LinkStatus(GLuint program){
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success;
+}
+
+void glWrap::ProgramCache::SetDirectory(const std::string& directory){
+    std::lock_guard<std::mutex> lock(programCacheMutex);
+    programCacheDirectory = directory;
+}
+
+std::string glWrap::ProgramCache::GetDirectory(){
+    std::lock_guard<std::mutex> lock(programCacheMutex);
+    return programCacheDirectory;
+}
+
+static std::vector<GLint> ProgramBinaryFormats(){
+    int count{};
+    if (glProgramBinary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+
+    std::vector<GLint> formats(count);
+    if (count) glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+    return formats;
+}
+
+bool glWrap::ProgramCache::IsSupported(){ return !ProgramBinaryFormats().empty(); }
+
+unsigned int glWrap::ProgramCache::GetHits(){ return programCacheHits; }
+unsigned int glWrap::ProgramCache::GetMisses(){ return programCacheMisses; }
+
+glWrap::ProgramCache::Build glWrap::ProgramCache::Start(const std::vector<std::pair<GLenum, std::string>>& stages){
+    Build build;
+    build.program = glCreateProgram();
+    std::string directory = GetDirectory();
+    std::vector<GLint> formats = ProgramBinaryFormats();
+
+    if (!directory.empty() && !formats.empty()){
+        // A driver update changes the strings and with them the file, old binaries are never tried
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) hash = HashString(hash, (const char*)glGetString(name));
+
+        for (const std::pair<GLenum, std::string>& stage : stages){
+            hash = HashBytes(hash, &stage.first, sizeof(stage.first));
+            hash = HashString(hash, stage.second.c_str());
+        }
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+        std::string path = directory + "/" + name;
+
+        std::ifstream file(path, std::ios::binary);
+        GLenum format{};
+        std::vector<char> binary;
+
+        // Unknown formats would raise an error, the file is damaged or from another driver
+        if (file.read((char*)&format, sizeof(format)) && std::find(formats.begin(), formats.end(), (GLint)format) != formats.end()){
+            binary.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            glProgramBinary(build.program, format, binary.data(), (GLsizei)binary.size());
+
+            // Loading a binary doesn't compile, so waiting for it here is cheap
+            if (LinkStatus(build.program)){
+                ++programCacheHits;
+                return build;
+            }
+        }
+
+        ++programCacheMisses;
+        build.path = path;
+        glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    build.shaders.resize(stages.size());
+    for (size_t i{}; i < stages.size(); ++i){
+        CreateShader(build.shaders[i], stages[i].first, stages[i].second);
+        glAttachShader(build.program, build.shaders[i]);
+    }
+
+    glLinkProgram(build.program);
+    return build;
+}
+
+bool glWrap::ProgramCache::IsDone(const Build& build){
+    if (build.shaders.empty() || !glMaxShaderCompilerThreadsKHR) return true;
+
+    int done;
+    glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+    return done;
+}
+
+void glWrap::ProgramCache::Finish(Build& build){
+    bool linked = LinkStatus(build.program);
+    char log[512];
+
+    if (!linked){
+        // A stage that didn't compile fails the link, its own log says why
+        for (unsigned int shader : build.shaders){
+            int success;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (success) continue;
+
+            glGetShaderInfoLog(shader, 512, NULL, log);
+            DEV_LOG("Failed compile: ", log);
+        }
+
+        glGetProgramInfoLog(build.program, 512, NULL, log);
+        DEV_LOG("Failed linking: ", log);
+    }
+
+    for (unsigned int shader : build.shaders){
+        glDetachShader(build.program, shader);
+        glDeleteShader(shader);
+    }
+
+    build.shaders.clear();
+    if (!linked || build.path.empty()) return;
+
+    int length{};
+    glGetProgramiv(build.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    std::vector<char> binary(length);
+    GLenum format{};
+    glGetProgramBinary(build.program, length, &length, &format, binary.data());
+
+    std::ofstream file(build.path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)&format, sizeof(format));
+    file.write(binary.data(), length);
+    if (!file) DEV_LOG("Program binary not written: ", build.path);
+
+    build.path.clear();
+}
+
+GLuint glWrap::ProgramCache::Link(const std::vector<std::pair<GLenum, std::string>>& stages){
+    Build build = Start(stages);
+    Finish(build);
+    return build.program;
+}
+
+// 
+// *SHADER BATCH
+// 
+
+std::shared_ptr<glWrap::Shader> glWrap::ShaderBatch::Add(const std::vector<std::pair<GLenum, std::string>>& stages){
+    std::shared_ptr<Shader> shader(new Shader());
+    Pending pending{shader, ProgramCache::Start(stages)};
+    shader->m_ID = pending.build.program;
+
+    if (!pending.build.shaders.empty()) m_pending.push_back(pending); // None when loaded from its binary
+    return shader;
+}
+
+std::shared_ptr<glWrap::Shader> glWrap::ShaderBatch::Add(std::string vertexPath, std::string fragmentPath){
+    return Add({{GL_VERTEX_SHADER, ExtractFile(vertexPath)}, {GL_FRAGMENT_SHADER, ExtractFile(fragmentPath)}});
+}
+
+std::shared_ptr<glWrap::Shader> glWrap::ShaderBatch::Add(const char* vertexShader, const char* fragmentShader, bool isText){
+    return Add({{GL_VERTEX_SHADER, vertexShader}, {GL_FRAGMENT_SHADER, fragmentShader}});
+}
+
+bool glWrap::ShaderBatch::IsReady(){
+    for (size_t i{}; i < m_pending.size();){
+        if (!ProgramCache::IsDone(m_pending[i].build)){
+            ++i;
+            continue;
+        }
+
+        ProgramCache::Finish(m_pending[i].build);
+        m_pending.erase(m_pending.begin() + i);
+    }
+
+    return m_pending.empty();
+}
+
+void glWrap::ShaderBatch::Wait(){
+    for (Pending& pending : m_pending) ProgramCache::Finish(pending.build);
+    m_pending.clear();
+}
+
+size_t glWrap::ShaderBatch::GetPending(){ return m_pending.size(); }
+bool glWrap::ShaderBatch::IsParallel(){ return glMaxShaderCompilerThreadsKHR != nullptr; }
+
+void glWrap::ShaderBatch::SetCompilerThreads(unsigned int count){
+    if (glMaxShaderCompilerThreadsKHR) glMaxShaderCompilerThreadsKHR(count);
+}
+
+glWrap::ShaderBatch::~ShaderBatch(){ Wait(); }
+
+// 
+// *SHADER
+// 
+
+glWrap::Shader::Shader(std::string vertexPath, std::string fragmentPath){
+    m_ID = ProgramCache::Link({{GL_VERTEX_SHADER, ExtractFile(vertexPath)}, {GL_FRAGMENT_SHADER, ExtractFile(fragmentPath)}});
+}
+
+glWrap::Shader::Shader(const char* vertexShader, const char* fragmentShader, bool isText){
+    m_ID = ProgramCache::Link({{GL_VERTEX_SHADER, vertexShader}, {GL_FRAGMENT_SHADER, fragmentShader}});
+}
+
+void glWrap::Shader::Use(){
+    StateCache::Current().UseProgram(m_ID);
+}
+
+unsigned int glWrap::Shader::GetID(){ return m_ID; }
+int glWrap::Shader::GetUniformLocation(const std::string& name){ return glGetUniformLocation(m_ID, name.c_str()); }
+bool glWrap::Shader::IsTransparent(){ return m_transparent; }
+void glWrap::Shader::SetTransparent(bool isTrue){ m_transparent = isTrue; }
+
+void glWrap::Shader::Update(){ Update(m_uniforms); }
+
+void glWrap::Shader::Update(const Uniforms& uniforms){ Update(m_ID, uniforms); }
+
+void glWrap::Shader::Update(unsigned int program, const Uniforms& uniforms, const TextureBinding* bindings){
+    for (auto const& value : uniforms.bools){
+        if (glGetUniformLocation(program, value.first.c_str()) != -1)
+            glUniform1i(glGetUniformLocation(program, value.first.c_str()), (int)value.second);
+    }
+
+    for (auto const& value : uniforms.ints){
+        if (glGetUniformLocation(program, value.first.c_str()) != -1)
+        glUniform1i(glGetUniformLocation(program, value.first.c_str()), value.second);
+    }
+
+    for (auto const& value : uniforms.floats){
+        if (glGetUniformLocation(program, value.first.c_str()) != -1)
+        glUniform1f(glGetUniformLocation(program, value.first.c_str()), value.second);
+    }
+
+    for (auto const& value : uniforms.mat4s){
+        if (glGetUniformLocation(program, value.first.c_str()) != -1)
+        glUniformMatrix4fv(glGetUniformLocation(program, value.first.c_str()), 1, GL_FALSE, glm::value_ptr(value.second));
+    }
+
+    unsigned int unit = 0;
+    // Textures bind their own sampler, overrides replace it on the unit
+    auto bindSampler = [&uniforms](const std::string& name, unsigned int unit){
+        auto sampler = uniforms.samplers.find(name);
+        if (sampler != uniforms.samplers.end()) StateCache::Current().BindSampler(unit, SamplerCache::Get(sampler->second));
+    };
+
+    // Snapshotted names are indexed in map order, textures first, whether the program uses them or not
+    auto bind = [bindings](size_t index, unsigned int unit){
+        StateCache::Current().BindTexture(unit, bindings[index].target, bindings[index].texture);
+        StateCache::Current().BindSampler(unit, bindings[index].sampler);
+    };
+
+    size_t index = 0;
+    for (auto const& value : uniforms.textures){
+        if (glGetUniformLocation(program, value.first.c_str()) != -1){
+            if (bindings) bind(index, unit);
+            else value.second->SetActive(unit);
+            bindSampler(value.first, unit);
+            glUniform1i(glGetUniformLocation(program, value.first.c_str()), unit);
+            ++unit;
+        }
+        ++index;
+    }
+
+    for (auto const& value : uniforms.textureArrays){
+        if (glGetUniformLocation(program, value.first.c_str()) != -1){
+            if (bindings) bind(index, unit);
+            else value.second->SetActive(unit);
+            bindSampler(value.first, unit);
+            glUniform1i(glGetUniformLocation(program, value.first.c_str()), unit);
+            ++unit;
+        }
+        ++index;
+    }
+}
+
+void glWrap::Shader::GetBindings(const Uniforms& uniforms, std::vector<TextureBinding>& bindings){
+    bindings.clear();
+    for (auto const& value : uniforms.textures) bindings.push_back({GL_TEXTURE_2D, value.second->m_ID, value.second->GetSamplerID()});
+    for (auto const& value : uniforms.textureArrays) bindings.push_back({GL_TEXTURE_2D_ARRAY, value.second->m_ID, value.second->GetSamplerID()});
+}
+
+const glWrap::Shader::Uniforms& glWrap::Shader::GetUniforms(){ return m_uniforms; }
+
+void glWrap::Shader::SetBool(const std::string name, bool value){ m_uniforms.bools[name] = value; }
+void glWrap::Shader::SetInt(const std::string name, int value){ m_uniforms.ints[name] = value; }
+void glWrap::Shader::SetFloat(const std::string name, float value){ m_uniforms.floats[name] = value; }
+void glWrap::Shader::SetMatrix4(const std::string name, glm::mat4 mat){ m_uniforms.mat4s[name] = mat; }
+void glWrap::Shader::SetTexture(const std::string name, Texture2D* texture){
+    if (texture) m_uniforms.textures[name] = texture;
+    else m_uniforms.textures.erase(name); // Null unbinds, nothing is left to hash or bind
+}
+
+void glWrap::Shader::SetTextureArray(const std::string name, Texture2DArray* texture){
+    if (texture) m_uniforms.textureArrays[name] = texture;
+    else m_uniforms.textureArrays.erase(name);
+}
+
+void glWrap::Shader::SetSampler(const std::string name, const SamplerState& sampler){ m_uniforms.samplers[name] = sampler; }
+
+// Hashed when read, streamed textures get a new name whenever their levels change
+unsigned int glWrap::Shader::GetTextureKey(){
+    unsigned int key{};
+    for (auto const& value : m_uniforms.textures){
+        key = key * 31 + value.second->m_ID;
+    }
+
+    for (auto const& value : m_uniforms.textureArrays){
+        key = key * 31 + value.second->m_ID;
+    }
+
+    return key;
+}
+
+// 
+// *SHADER VARIANTS
+// 
+
+// Defines go after the #version line, which has to stay first
+static std::string DefineKeywords(const std::string& source, const std::vector<std::string>& keywords, uint64_t key){
+    std::string defines;
+    for (size_t i{}; i < keywords.size(); ++i){
+        if (key >> i & 1) defines += "#define " + keywords[i] + " 1\n";
+    }
+
+    size_t line = source.find("#version");
+    line = line == std::string::npos ? 0 : std::min(source.find('\n', line), source.size() - 1) + 1;
+
+    std::string head = source.substr(0, line);
+    if (!head.empty() && head.back() != '\n') head += '\n';
+    return head + defines + source.substr(line);
+}
+
+void glWrap::ShaderVariants::ReadKeywords(const std::string& source){
+    std::istringstream lines(source);
+    std::string line;
+
+    while (std::getline(lines, line)){
+        std::istringstream words(line);
+        std::string directive, pragma, keyword;
+        words >> directive >> pragma;
+
+        // Also written with a space after the hash
+        if (directive == "#"){
+            directive += pragma;
+            words >> pragma;
+        }
+        if (directive != "#pragma" || pragma != "keywords") continue;
+
+        while (words >> keyword){
+            if (std::find(m_keywords.begin(), m_keywords.end(), keyword) != m_keywords.end()) continue;
+
+            if (m_keywords.size() == 64){
+                DEV_LOG("Too many shader keywords, ignored: ", keyword);
+                continue;
+            }
+
+            m_keywords.push_back(keyword);
+        }
+    }
+}
+
+glWrap::ShaderVariants::ShaderVariants(std::string vertexPath, std::string fragmentPath, const std::vector<std::vector<std::string>>& precompile)
+    : ShaderVariants(ExtractFile(vertexPath).c_str(), ExtractFile(fragmentPath).c_str(), true, precompile){}
+
+glWrap::ShaderVariants::ShaderVariants(const char* vertexShader, const char* fragmentShader, bool isText, const std::vector<std::vector<std::string>>& precompile)
+    : m_vertex{vertexShader}, m_fragment{fragmentShader}{
+    ReadKeywords(m_vertex);
+    ReadKeywords(m_fragment);
+
+    std::vector<uint64_t> keys;
+    for (const std::vector<std::string>& keywords : precompile) keys.push_back(GetKey(keywords));
+    Precompile(keys);
+}
+
+uint64_t glWrap::ShaderVariants::GetKey(const std::vector<std::string>& keywords){
+    uint64_t key{};
+
+    for (const std::string& keyword : keywords){
+        auto bit = std::find(m_keywords.begin(), m_keywords.end(), keyword);
+        if (bit != m_keywords.end()) key |= 1ull << (bit - m_keywords.begin());
+        else DEV_LOG("Unknown shader keyword: ", keyword);
+    }
+
+    return key;
+}
+
+glWrap::Shader* glWrap::ShaderVariants::Get(uint64_t key){
+    std::shared_ptr<Shader>& variant = m_variants[key];
+
+    if (!variant){
+        std::string vertex = DefineKeywords(m_vertex, m_keywords, key), fragment = DefineKeywords(m_fragment, m_keywords, key);
+        variant = std::make_shared<Shader>(vertex.c_str(), fragment.c_str(), true);
+    }
+
+    return variant.get();
+}
+
+glWrap::Shader* glWrap::ShaderVariants::Get(const std::vector<std::string>& keywords){ return Get(GetKey(keywords)); }
+
+void glWrap::ShaderVariants::Precompile(const std::vector<uint64_t>& keys){
+    // Every compile is issued before any is waited for
+    ShaderBatch batch;
+
+    for (uint64_t key : keys){
+        std::shared_ptr<Shader>& variant = m_variants[key];
+        if (variant) continue;
+
+        std::string vertex = DefineKeywords(m_vertex, m_keywords, key), fragment = DefineKeywords(m_fragment, m_keywords, key);
+        variant = batch.Add(vertex.c_str(), fragment.c_str(), true);
+    }
+
+    batch.Wait();
+}
+
+const std::vector<std::string>& glWrap::ShaderVariants::GetKeywords(){ return m_keywords; }
+size_t glWrap::ShaderVariants::Size(){ return m_variants.size(); }
+
+// 
+// *WorldObject
+//
+
+static glm::quat EulerToQuaternion(glm::vec3 degrees){
+    return glm::angleAxis(glm::radians(degrees.x), glm::vec3(1.0f, 0.0f, 0.0f))
+         * glm::angleAxis(glm::radians(degrees.y), glm::vec3(0.0f, 1.0f, 0.0f))
+         * glm::angleAxis(glm::radians(degrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+static glm::vec3 QuaternionToEuler(glm::quat orientation){ // Inverse of EulerToQuaternion
+    glm::mat3 rotation = glm::mat3_cast(orientation);
+
+    // Z is taken from the matrix with X undone, which stays exact near Y = +-90 where X and Z mix
+    float x = std::atan2(-rotation[2][1], rotation[2][2]);
+    float y = std::atan2(rotation[2][0], std::sqrt(rotation[0][0] * rotation[0][0] + rotation[1][0] * rotation[1][0]));
+    float cx = std::cos(x), sx = std::sin(x);
+    float z = std::atan2(cx * rotation[0][1] + sx * rotation[0][2], cx * rotation[1][1] + sx * rotation[1][2]);
+
+    return glm::degrees(glm::vec3(x, y, z));
+}
+
+void glWrap::WorldObject::UpdateBasis(){
+    if (m_basisVersion == m_version) return;
+
+    // Yaw around Z and pitch around Y as the Euler setters always meant them, not the model matrix axes
+    m_forward = glm::normalize(glm::vec3{
+        (cos(glm::radians(m_transform.rot.z)) * cos(glm::radians(m_transform.rot.y))),
+        sin(glm::radians(m_transform.rot.y)),
+        (sin(glm::radians(m_transform.rot.z)) * cos(glm::radians(m_transform.rot.y)))});
+    m_right = glm::normalize(glm::cross(m_forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    m_up = glm::normalize(glm::cross(m_right, m_forward));
+    m_basisVersion = m_version;
+}
+
+glm::vec3 glWrap::WorldObject::GetForwardVector(){ UpdateBasis(); return m_forward; }
+glm::vec3 glWrap::WorldObject::GetRightVector(){ UpdateBasis(); return m_right; }
+glm::vec3 glWrap::WorldObject::GetUpwardVector(){ UpdateBasis(); return m_up; }
+glm::quat glWrap::WorldObject::GetOrientation(){ return m_orientation; }
+
+glm::mat4 glWrap::WorldObject::GetTransformMatrix(){
+    if (m_matrixVersion != m_version){
+        // translate * scale * rotate, the scale multiplies the rows of the rotation
+        glm::mat3 rotation = glm::mat3_cast(m_orientation);
+
+        for (int column{}; column < 3; ++column) m_matrix[column] = glm::vec4(rotation[column] * m_transform.scl, 0.0f);
+        m_matrix[3] = glm::vec4(m_transform.pos, 1.0f);
+        m_matrixVersion = m_version;
+    }
+
+    return m_matrix;
+}
+
+void glWrap::WorldObject::UpdateTransformMatrices(WorldObject* const* objects, size_t count){
+    thread_local std::vector<WorldObject*> stale;
+    thread_local std::vector<Transform> transforms;
+    thread_local std::vector<glm::mat4> matrices;
+
+    stale.clear();
+    transforms.clear();
+
+    // The Euler degrees are kept in sync with the quaternion, so the kernel composes the same matrix
+    for (size_t i{}; i < count; ++i){
+        if (objects[i]->m_matrixVersion == objects[i]->m_version) continue;
+
+        stale.push_back(objects[i]);
+        transforms.push_back(objects[i]->m_transform);
+    }
+
+    matrices.resize(stale.size());
+    TransformBatch::Compose(transforms.data(), matrices.data(), stale.size());
+
+    for (size_t i{}; i < stale.size(); ++i){
+        stale[i]->m_matrix = matrices[i];
+        stale[i]->m_matrixVersion = stale[i]->m_version;
+    }
+}
+
+unsigned int glWrap::WorldObject::GetVersion(){ return m_version; }
+
+void glWrap::WorldObject::SetTransform(Transform transform){ m_transform = transform; m_orientation = EulerToQuaternion(transform.rot); ++m_version; }
+void glWrap::WorldObject::SetPosition(glm::vec3 position){ m_transform.pos = position; ++m_version; }
+void glWrap::WorldObject::SetRotation(glm::vec3 rotation){ m_transform.rot = rotation; m_orientation = EulerToQuaternion(rotation); ++m_version; }
+void glWrap::WorldObject::SetScale(glm::vec3 scale){ m_transform.scl = scale; ++m_version; }
+
+void glWrap::WorldObject::SetOrientation(glm::quat orientation){
+    m_orientation = glm::normalize(orientation);
+    m_transform.rot = QuaternionToEuler(m_orientation);
+    ++m_version;
+}
+
+void glWrap::WorldObject::AddPosition(glm::vec3 position){ m_transform.pos += position; ++m_version; }
+void glWrap::WorldObject::AddRotation(glm::vec3 rotation){ SetRotation(m_transform.rot + rotation); }
+void glWrap::WorldObject::AddScale(glm::vec3 scale){ m_transform.scl += scale; ++m_version; }
+
+void glWrap::WorldObject::Rotate(float degrees, glm::vec3 axis){ SetOrientation(m_orientation * glm::angleAxis(glm::radians(degrees), axis)); }
+void glWrap::WorldObject::RotateWorld(float degrees, glm::vec3 axis){ SetOrientation(glm::angleAxis(glm::radians(degrees), axis) * m_orientation); }
+
+// 
+// *Transform batch
+// 
+
+// translate * scale * rotateX * rotateY * rotateZ, written out. The scale applies to the rows
+// of the rotation since it is multiplied in before it
+static void ComposeScalar(const float* component, glm::mat4& matrix){
+    float x = glm::radians(component[3]), y = glm::radians(component[4]), z = glm::radians(component[5]);
+    float cx = std::cos(x), sx = std::sin(x);
+    float cy = std::cos(y), sy = std::sin(y);
+    float cz = std::cos(z), sz = std::sin(z);
+
+    matrix[0] = glm::vec4(component[6] * cy * cz, component[7] * (cx * sz + sx * sy * cz), component[8] * (sx * sz - cx * sy * cz), 0.0f);
+    matrix[1] = glm::vec4(component[6] * -cy * sz, component[7] * (cx * cz - sx * sy * sz), component[8] * (sx * cz + cx * sy * sz), 0.0f);
+    matrix[2] = glm::vec4(component[6] * sy, component[7] * -sx * cy, component[8] * cx * cy, 0.0f);
+    matrix[3] = glm::vec4(component[0], component[1], component[2], 1.0f);
+}
+
+#if defined(GW_SIMD_AVX) || defined(GW_SIMD_SSE)
+
+#if defined(GW_SIMD_AVX)
+typedef __m256 SimdFloat;
+const int simdWidth = 8;
+
+static inline SimdFloat SimdSet(float value){ return _mm256_set1_ps(value); }
+static inline SimdFloat SimdLoad(const float* data){ return _mm256_loadu_ps(data); }
+static inline void SimdStore(float* data, SimdFloat value){ _mm256_storeu_ps(data, value); }
+static inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b){ return _mm256_add_ps(a, b); }
+static inline SimdFloat SimdSub(SimdFloat a, SimdFloat b){ return _mm256_sub_ps(a, b); }
+static inline SimdFloat SimdMul(SimdFloat a, SimdFloat b){ return _mm256_mul_ps(a, b); }
+static inline SimdFloat SimdRound(SimdFloat a){ return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+static inline SimdFloat SimdFloor(SimdFloat a){ return _mm256_floor_ps(a); }
+static inline SimdFloat SimdEqual(SimdFloat a, SimdFloat b){ return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b){ return _mm256_blendv_ps(b, a, mask); }
+#else
+typedef __m128 SimdFloat;
+const int simdWidth = 4;
+
+static inline SimdFloat SimdSet(float value){ return _mm_set1_ps(value); }
+static inline SimdFloat SimdLoad(const float* data){ return _mm_loadu_ps(data); }
+static inline void SimdStore(float* data, SimdFloat value){ _mm_storeu_ps(data, value); }
+static inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b){ return _mm_add_ps(a, b); }
+static inline SimdFloat SimdSub(SimdFloat a, SimdFloat b){ return _mm_sub_ps(a, b); }
+static inline SimdFloat SimdMul(SimdFloat a, SimdFloat b){ return _mm_mul_ps(a, b); }
+static inline SimdFloat SimdRound(SimdFloat a){ return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+static inline SimdFloat SimdFloor(SimdFloat a){
+    SimdFloat truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.0f)));
+}
+static inline SimdFloat SimdEqual(SimdFloat a, SimdFloat b){ return _mm_cmpeq_ps(a, b); }
+static inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b){ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+#endif
+
+// Sine and cosine of degrees. Reduced to [-pi/4, pi/4] around the nearest quarter turn, then the
+// quarter selects which polynomial and sign each result takes
+static void SimdSinCos(SimdFloat degrees, SimdFloat& sine, SimdFloat& cosine){
+    SimdFloat x = SimdMul(degrees, SimdSet(glm::pi<float>() / 180.0f));
+    SimdFloat quarter = SimdRound(SimdMul(x, SimdSet(2.0f / glm::pi<float>())));
+
+    // pi / 2 split in three so the products stay exact
+    x = SimdSub(x, SimdMul(quarter, SimdSet(1.5703125f)));
+    x = SimdSub(x, SimdMul(quarter, SimdSet(4.837512969970703125e-4f)));
+    x = SimdSub(x, SimdMul(quarter, SimdSet(7.54978995489188216e-8f)));
+
+    SimdFloat x2 = SimdMul(x, x);
+
+    SimdFloat s = SimdAdd(SimdMul(x2, SimdSet(-1.9515295891e-4f)), SimdSet(8.3321608736e-3f));
+    s = SimdAdd(SimdMul(s, x2), SimdSet(-1.6666654611e-1f));
+    s = SimdAdd(SimdMul(SimdMul(s, x2), x), x);
+
+    SimdFloat c = SimdAdd(SimdMul(x2, SimdSet(2.443315711809948e-5f)), SimdSet(-1.388731625493765e-3f));
+    c = SimdAdd(SimdMul(c, x2), SimdSet(4.166664568298827e-2f));
+    c = SimdAdd(SimdSub(SimdMul(SimdMul(c, x2), x2), SimdMul(x2, SimdSet(0.5f))), SimdSet(1.0f));
+
+    SimdFloat turn = SimdSub(quarter, SimdMul(SimdFloor(SimdMul(quarter, SimdSet(0.25f))), SimdSet(4.0f))); // 0 to 3
+    SimdFloat odd = SimdEqual(SimdSub(turn, SimdMul(SimdFloor(SimdMul(turn, SimdSet(0.5f))), SimdSet(2.0f))), SimdSet(1.0f));
+
+    SimdFloat negativeSine = SimdSelect(SimdEqual(SimdFloor(SimdMul(turn, SimdSet(0.5f))), SimdSet(1.0f)), SimdSet(-1.0f), SimdSet(1.0f));
+    SimdFloat negativeCosine = SimdSelect(SimdEqual(turn, SimdSet(1.0f)), SimdSet(-1.0f), SimdSelect(SimdEqual(turn, SimdSet(2.0f)), SimdSet(-1.0f), SimdSet(1.0f)));
+
+    sine = SimdMul(SimdSelect(odd, c, s), negativeSine);
+    cosine = SimdMul(SimdSelect(odd, s, c), negativeCosine);
+}
+
+// simdWidth matrices from component arrays, each pointing at simdWidth values
+static void ComposeSimd(const float* const* component, glm::mat4* matrices){
+    SimdFloat sx, cx, sy, cy, sz, cz;
+    SimdSinCos(SimdLoad(component[3]), sx, cx);
+    SimdSinCos(SimdLoad(component[4]), sy, cy);
+    SimdSinCos(SimdLoad(component[5]), sz, cz);
+
+    SimdFloat scaleX = SimdLoad(component[6]), scaleY = SimdLoad(component[7]), scaleZ = SimdLoad(component[8]);
+    SimdFloat sxsy = SimdMul(sx, sy), cxsy = SimdMul(cx, sy);
+
+    SimdFloat columns[12] = {
+        SimdMul(scaleX, SimdMul(cy, cz)),
+        SimdMul(scaleY, SimdAdd(SimdMul(cx, sz), SimdMul(sxsy, cz))),
+        SimdMul(scaleZ, SimdSub(SimdMul(sx, sz), SimdMul(cxsy, cz))),
+        SimdMul(scaleX, SimdSub(SimdSet(0.0f), SimdMul(cy, sz))),
+        SimdMul(scaleY, SimdSub(SimdMul(cx, cz), SimdMul(sxsy, sz))),
+        SimdMul(scaleZ, SimdAdd(SimdMul(sx, cz), SimdMul(cxsy, sz))),
+        SimdMul(scaleX, sy),
+        SimdMul(scaleY, SimdSub(SimdSet(0.0f), SimdMul(sx, cy))),
+        SimdMul(scaleZ, SimdMul(cx, cy)),
+        SimdLoad(component[0]),
+        SimdLoad(component[1]),
+        SimdLoad(component[2])
+    };
+
+    alignas(32) float lanes[12][simdWidth];
+    for (int i{}; i < 12; ++i) SimdStore(lanes[i], columns[i]);
+
+    for (int lane{}; lane < simdWidth; ++lane){
+        glm::mat4& matrix = matrices[lane];
+        matrix[0] = glm::vec4(lanes[0][lane], lanes[1][lane], lanes[2][lane], 0.0f);
+        matrix[1] = glm::vec4(lanes[3][lane], lanes[4][lane], lanes[5][lane], 0.0f);
+        matrix[2] = glm::vec4(lanes[6][lane], lanes[7][lane], lanes[8][lane], 0.0f);
+        matrix[3] = glm::vec4(lanes[9][lane], lanes[10][lane], lanes[11][lane], 1.0f);
+    }
+}
+#endif
+
+void glWrap::TransformBatch::Compose(const Transform* transforms, glm::mat4* matrices, size_t count){
+    size_t i{};
+
+#if defined(GW_SIMD_AVX) || defined(GW_SIMD_SSE)
+    // Transpose each group into component arrays for the kernel
+    float components[9][simdWidth];
+    const float* pointers[9];
+    for (int c{}; c < 9; ++c) pointers[c] = components[c];
+
+    for (; i + simdWidth <= count; i += simdWidth){
+        for (int lane{}; lane < simdWidth; ++lane){
+            const float* source = &transforms[i + lane].pos.x;
+            for (int c{}; c < 9; ++c) components[c][lane] = source[c];
+        }
+
+        ComposeSimd(pointers, matrices + i);
+    }
+#endif
+
+    for (; i < count; ++i) ComposeScalar(&transforms[i].pos.x, matrices[i]);
+}
+
+unsigned int glWrap::TransformBatch::Add(const Transform& transform){
+    if (m_size % blockSize == 0){
+        for (std::vector<float>& component : m_components) component.resize(m_size + blockSize, 0.0f);
+        m_matrices.resize(m_size + blockSize, glm::mat4(1.0f));
+        m_dirty.push_back(0);
+    }
+
+    ++m_size;
+    Set(m_size - 1, transform);
+    return m_size - 1;
+}
+
+void glWrap::TransformBatch::Set(unsigned int index, const Transform& transform){
+    SetPosition(index, transform.pos);
+    SetRotation(index, transform.rot);
+    SetScale(index, transform.scl);
+}
+
+void glWrap::TransformBatch::SetPosition(unsigned int index, glm::vec3 position){
+    for (int c{}; c < 3; ++c) m_components[c][index] = position[c];
+    m_dirty[index / blockSize] = 1;
+}
+
+void glWrap::TransformBatch::SetRotation(unsigned int index, glm::vec3 rotation){
+    for (int c{}; c < 3; ++c) m_components[3 + c][index] = rotation[c];
+    m_dirty[index / blockSize] = 1;
+}
+
+void glWrap::TransformBatch::SetScale(unsigned int index, glm::vec3 scale){
+    for (int c{}; c < 3; ++c) m_components[6 + c][index] = scale[c];
+    m_dirty[index / blockSize] = 1;
+}
+
+glWrap::Transform glWrap::TransformBatch::Get(unsigned int index){
+    Transform transform;
+    for (int c{}; c < 3; ++c){
+        transform.pos[c] = m_components[c][index];
+        transform.rot[c] = m_components[3 + c][index];
+        transform.scl[c] = m_components[6 + c][index];
+    }
+
+    return transform;
+}
+
+size_t glWrap::TransformBatch::Size(){ return m_size; }
+
+void glWrap::TransformBatch::Clear(){
+    for (std::vector<float>& component : m_components) component.clear();
+    m_matrices.clear();
+    m_dirty.clear();
+    m_size = 0;
+}
+
+void glWrap::TransformBatch::Update(){ UpdateBlocks(0, m_dirty.size()); }
+
+void glWrap::TransformBatch::Update(JobSystem& jobs){
+    jobs.ParallelFor(m_dirty.size(), 256, [this](size_t begin, size_t end){ UpdateBlocks(begin, end); });
+}
+
+void glWrap::TransformBatch::UpdateBlocks(size_t begin, size_t end){
+    for (size_t block{begin}; block < end; ++block){
+        if (!m_dirty[block]) continue;
+
+        size_t first = block * blockSize;
+        const float* pointers[9];
+        for (int c{}; c < 9; ++c) pointers[c] = m_components[c].data() + first;
+
+#if defined(GW_SIMD_AVX) || defined(GW_SIMD_SSE)
+        for (size_t offset{}; offset < blockSize; offset += simdWidth){
+            ComposeSimd(pointers, &m_matrices[first + offset]);
+            for (int c{}; c < 9; ++c) pointers[c] += simdWidth;
+        }
+#else
+        float components[9];
+        for (size_t offset{}; offset < blockSize; ++offset){
+            for (int c{}; c < 9; ++c) components[c] = pointers[c][offset];
+            ComposeScalar(components, m_matrices[first + offset]);
+        }
+#endif
+
+        m_dirty[block] = 0;
+    }
+}
+
+const glm::mat4& glWrap::TransformBatch::GetMatrix(unsigned int index){ return m_matrices[index]; }
+const std::vector<glm::mat4>& glWrap::TransformBatch::GetMatrices(){ return m_matrices; }
+
+// 
+// *Camera
+// 
+
+float glWrap::Camera::GetFOV(){ return m_FOV; }
+glm::vec2 glWrap::Camera::GetClip(){ return m_clip; }
+void glWrap::Camera::UpdateView(){
+    // The target can move without the camera knowing, so its position is compared too
+    if (m_viewVersion == m_version && (!m_target || *m_target == m_viewTarget)) return;
+
+    if (m_target) m_viewTarget = *m_target;
+    m_view = glm::lookAt(m_transform.pos, m_target ? m_viewTarget : m_transform.pos + GetForwardVector(), GetUpwardVector());
+
+    m_viewVersion = m_version;
+    m_viewProjectionDirty = true;
+}
+
+void glWrap::Camera::UpdateProjection(glm::vec2 aspect){
+    if (!m_projectionDirty && aspect == m_aspect) return;
+
+    m_projection = m_perspective ? glm::perspective(glm::radians(m_FOV), (aspect.x / aspect.y), m_clip.x, m_clip.y ) : glm::ortho(0.0f, aspect.x, 0.0f, aspect.y, m_clip.x, m_clip.y);
+    m_aspect = aspect;
+    m_projectionDirty = false;
+    m_viewProjectionDirty = true;
+}
+
+void glWrap::Camera::UpdateViewProjection(glm::vec2 aspect){
+    UpdateView();
+    UpdateProjection(aspect);
+
+    if (!m_viewProjectionDirty) return;
+
+    m_viewProjection = m_projection * m_view;
+    m_frustum = Frustum(m_viewProjection);
+    m_viewProjectionDirty = false;
+}
+
+glm::mat4 glWrap::Camera::GetView(){ UpdateView(); return m_view; }
+glm::mat4 glWrap::Camera::GetProjection(glm::vec2 aspect){ UpdateProjection(aspect); return m_projection; }
+const glm::mat4& glWrap::Camera::GetViewProjection(glm::vec2 aspect){ UpdateViewProjection(aspect); return m_viewProjection; }
+const glWrap::Frustum& glWrap::Camera::GetFrustum(glm::vec2 aspect){ UpdateViewProjection(aspect); return m_frustum; }
+bool glWrap::Camera::IsPerspective(){ return m_perspective; }
+
+void glWrap::Camera::SetTarget(glm::vec3* target){ m_target = target; m_viewVersion = ~0u; }
+void glWrap::Camera::SetFOV(float FOV){ m_FOV = FOV; m_projectionDirty = true; }
+void glWrap::Camera::AddFOV(float FOV){ m_FOV += FOV; m_projectionDirty = true; }
+void glWrap::Camera::SetPerspective(bool isTrue){ m_perspective = isTrue; m_projectionDirty = true; }
+
+// 
+// *Mesh / Primitive
+// 
+
+void glWrap::Primitive::Draw(){
+
+    // DEV_LOG("Binding VAO: ", m_VAO);
+    StateCache::Current().BindVertexArray(m_VAO); // The EBO binding is captured by the VAO
+
+    // DEV_LOG("Drawing elements", "");
+    glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_SHORT, 0);
+}
+
+void glWrap::Primitive::DrawInstanced(GLuint instanceBuffer, unsigned int first, unsigned int count){
+
+    StateCache& state = StateCache::Current();
+    state.BindVertexArray(m_VAO);
+
+    size_t offset = first * sizeof(glm::mat4);
+
+    // The attribute pointers are VAO state, only repoint them when the range moved
+    if (m_instanceBuffer != instanceBuffer || m_instanceOffset != offset){
+        m_instanceBuffer = instanceBuffer;
+        m_instanceOffset = offset;
+        state.BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        SetInstanceAttributes(offset);
+    }
+
+    glDrawElementsInstanced(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_SHORT, 0, count);
+}
+
+void glWrap::Primitive::ComputeBounds(){
+    m_bounds = AABB{};
+    for (const Vertex& vertex : m_vertices) m_bounds.Expand(vertex.pos);
+}
+
+void glWrap::Mesh::ComputeBounds(){
+    m_bounds = AABB{};
+
+    for (Primitive& primitive : m_primitives){
+        primitive.ComputeBounds();
+        m_bounds.Expand(primitive.m_bounds);
+    }
+}
+
+void glWrap::GeometryPool::Add(Primitive& primitive){
+    primitive.m_baseVertex = m_vertices.size();
+    primitive.m_firstIndex = m_indices.size();
+
+    m_vertices.insert(m_vertices.end(), primitive.m_vertices.begin(), primitive.m_vertices.end());
+    m_indices.insert(m_indices.end(), primitive.m_indices.begin(), primitive.m_indices.end());
+    m_dirty = true;
+}
+
+void glWrap::GeometryPool::Bind(GLuint instanceBuffer){
+    StateCache& state = StateCache::Current();
+
+    if (!m_VAO){
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(1, &m_VBO);
+        glGenBuffers(1, &m_EBO);
+
+        state.BindVertexArray(m_VAO);
+        state.BindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        SetVertexAttributes();
+    }
+
+    state.BindVertexArray(m_VAO);
+
+    // Commands select their transforms with baseInstance, the pointer only moves between buffers
+    if (m_instanceBuffer != instanceBuffer){
+        m_instanceBuffer = instanceBuffer;
+        state.BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        SetInstanceAttributes(0);
+    }
+
+    if (!m_dirty) return;
+
+    state.BindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), m_vertices.data(), GL_STATIC_DRAW);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned short), m_indices.data(), GL_STATIC_DRAW);
+
+    m_dirty = false;
+}
+
+void glWrap::GeometryPool::Release(){
+    if (!m_VAO) return;
+
+    StateCache& state = StateCache::Current();
+    state.DeleteVertexArray(m_VAO);
+    state.DeleteBuffer(m_VBO);
+    state.DeleteBuffer(m_EBO);
+    m_VAO = m_VBO = m_EBO = m_instanceBuffer = 0;
+}
+
+// 
+// *Instance
+// 
+
+void glWrap::Instance::SetMesh(Mesh* mesh){
+    m_mesh = mesh;
+    ++m_version;
+    m_shaders.resize(mesh->m_primitives.size());
+    // DEV_LOG("Shaders required: ", m_shaders.size());
+}
+
+void glWrap::Instance::SetShader(Shader* shader, int primitive){
+    if (primitive < m_shaders.size()){
+        m_shaders[primitive] = shader;
+    }
+    else {
+        DEV_LOG("Wrong primitive index, max is: ", m_shaders.size() - 1);
+    }
+}
+
+void glWrap::Instance::SetVisibility(bool visibility){ m_visible = visibility; ++m_version; }
+void glWrap::Instance::SetOccluder(Mesh* mesh){ m_occluder = mesh; }
+
+glWrap::Mesh* glWrap::Instance::GetMesh(){ return m_mesh; }
+glWrap::Mesh* glWrap::Instance::GetOccluder(){ return m_occluder; }
+
+glWrap::Shader* glWrap::Instance::GetShader(int primitive){
+    if (primitive < m_shaders.size()){
+        return m_shaders[primitive];
+    }
+    else {
+        // DEV_LOG("Wrong primitive index, max is: ", m_shaders.size() - 1);
+        return nullptr;
+    }
+}
+
+bool glWrap::Instance::GetVisibility(){ return m_visible; }
+
+const glWrap::AABB& glWrap::Instance::GetWorldBounds(){
+    if (m_boundsVersion != m_version){
+        m_worldBounds = m_mesh ? m_mesh->m_bounds.Transformed(GetTransformMatrix()) : AABB{};
+        m_boundsVersion = m_version;
+    }
+
+    return m_worldBounds;
+}
+
+// 
+// *Scene
+// 
+
+static float SurfaceArea(const glWrap::AABB& box){
+    if (box.IsEmpty()) return 0.0f;
+
+    glm::vec3 size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// Slab test, returns the entry distance or a negative value on a miss
+static float IntersectRay(const glWrap::AABB& box, glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance){
+    glm::vec3 t0 = (box.min - origin) * inverseDirection;
+    glm::vec3 t1 = (box.max - origin) * inverseDirection;
+    glm::vec3 tMin = glm::min(t0, t1);
+    glm::vec3 tMax = glm::max(t0, t1);
+
+    float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+    float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+
+    return enter <= exit ? enter : -1.0f;
+}
+
+// Moller-Trumbore, returns the hit distance or a negative value on a miss
+static float IntersectTriangle(glm::vec3 origin, glm::vec3 direction, glm::vec3 a, glm::vec3 b, glm::vec3 c){
+    glm::vec3 edge1 = b - a;
+    glm::vec3 edge2 = c - a;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+
+    if (std::abs(determinant) < 1e-8f) return -1.0f;
+
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = origin - a;
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) return -1.0f;
+
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) return -1.0f;
+
+    return glm::dot(edge2, q) * inverse;
+}
+
+void glWrap::Scene::Add(Instance* instance, bool isStatic){
+    m_instances.push_back(instance);
+    m_static.push_back(isStatic);
+    m_dirty = true;
+    ++m_generation;
+}
+
+void glWrap::Scene::Remove(Instance* instance){
+    auto it = std::find(m_instances.begin(), m_instances.end(), instance);
+    if (it == m_instances.end()) return;
+
+    m_static.erase(m_static.begin() + (it - m_instances.begin()));
+    m_instances.erase(it);
+    m_dirty = true;
+    ++m_generation;
+}
+
+size_t glWrap::Scene::Size(){ return m_instances.size(); }
+unsigned int glWrap::Scene::GetGeneration(){ return m_generation; }
+const std::vector<glWrap::Instance*>& glWrap::Scene::GetInstances(){ return m_instances; }
+bool glWrap::Scene::IsStatic(size_t index){ return m_static[index]; }
+
+void glWrap::Scene::Build(){
+    m_nodes.clear();
+    m_order.clear();
+    m_unbounded.clear();
+    m_bounds.resize(m_instances.size());
+    m_centroids.resize(m_instances.size());
+    m_versions.resize(m_instances.size());
+    m_leafOf.assign(m_instances.size(), ~0u);
+
+    for (unsigned int i{}; i < m_instances.size(); ++i){
+        m_bounds[i] = m_instances[i]->GetWorldBounds();
+        m_centroids[i] = m_bounds[i].GetCenter();
+        m_versions[i] = m_instances[i]->GetVersion();
+
+        if (m_bounds[i].IsEmpty()) m_unbounded.push_back(m_instances[i]);
+        else m_order.push_back(i);
+    }
+
+    if (!m_order.empty()){
+        m_nodes.reserve(m_order.size() * 2);
+        m_nodes.push_back({});
+        BuildNode(0, 0, m_order.size(), 0);
+    }
+
+    m_builtCost = GetCost();
+    m_refits = 0;
+    m_dirty = false;
+}
+
+void glWrap::Scene::BuildNode(unsigned int node, unsigned int first, unsigned int count, unsigned int parent){
+    const int binCount = 12;
+    const unsigned int maxLeafSize = 4;
+
+    AABB bounds, centroids;
+    for (unsigned int i{first}; i < first + count; ++i){
+        bounds.Expand(m_bounds[m_order[i]]);
+        centroids.Expand(m_centroids[m_order[i]]);
+    }
+
+    m_nodes[node] = {bounds, first, count, 0, parent};
+
+    // Binned surface area heuristic over the centroid extent of every axis
+    float bestCost = count * SurfaceArea(bounds);
+    int bestAxis = -1;
+    int bestSplit{};
+
+    for (int axis{}; axis < 3 && count > 1; ++axis){
+        float extent = centroids.max[axis] - centroids.min[axis];
+        if (extent <= 0.0f) continue;
+
+        AABB binBounds[binCount];
+        unsigned int binCounts[binCount]{};
+
+        for (unsigned int i{first}; i < first + count; ++i){
+            int bin = std::min(binCount - 1, (int)((m_centroids[m_order[i]][axis] - centroids.min[axis]) / extent * binCount));
+            binBounds[bin].Expand(m_bounds[m_order[i]]);
+            ++binCounts[bin];
+        }
+
+        float rightCosts[binCount]{};
+        AABB right;
+        unsigned int rightCount{};
+        for (int bin{binCount - 1}; bin > 0; --bin){
+            right.Expand(binBounds[bin]);
+            rightCount += binCounts[bin];
+            rightCosts[bin] = rightCount * SurfaceArea(right);
+        }
+
+        AABB left;
+        unsigned int leftCount{};
+        for (int bin{}; bin < binCount - 1; ++bin){
+            left.Expand(binBounds[bin]);
+            leftCount += binCounts[bin];
+
+            float cost = leftCount * SurfaceArea(left) + rightCosts[bin + 1];
+            if (leftCount && leftCount < count && cost < bestCost){
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = bin + 1;
+            }
+        }
+    }
+
+    unsigned int leftCount{};
+
+    if (bestAxis >= 0){
+        float extent = centroids.max[bestAxis] - centroids.min[bestAxis];
+        auto middle = std::partition(m_order.begin() + first, m_order.begin() + first + count, [&](unsigned int index){
+            return std::min(binCount - 1, (int)((m_centroids[index][bestAxis] - centroids.min[bestAxis]) / extent * binCount)) < bestSplit;
+        });
+        leftCount = middle - (m_order.begin() + first);
+    }
+    else if (count > maxLeafSize){
+        leftCount = count / 2; // Coincident centroids, split anywhere to bound the leaf size
+    }
+
+    if (leftCount == 0 || leftCount == count){
+        for (unsigned int i{first}; i < first + count; ++i) m_leafOf[m_order[i]] = node;
+        return;
+    }
+
+    unsigned int left = m_nodes.size();
+    m_nodes[node].left = left;
+    m_nodes.push_back({});
+    m_nodes.push_back({});
+
+    BuildNode(left, first, leftCount, node);
+    BuildNode(left + 1, first + leftCount, count - leftCount, node);
+}
+
+float glWrap::Scene::GetCost(){
+    if (m_nodes.empty()) return 0.0f;
+
+    float cost{};
+    for (const Node& node : m_nodes){
+        cost += SurfaceArea(node.bounds) * (node.left ? 1.0f : node.count);
+    }
+
+    return cost / std::max(SurfaceArea(m_nodes[0].bounds), 1e-6f);
+}
+
+void glWrap::Scene::Update(){
+    if (m_dirty){
+        Build();
+        return;
+    }
+
+    bool moved{false};
+
+    for (unsigned int i{}; i < m_instances.size(); ++i){
+        if (m_static[i] || m_instances[i]->GetVersion() == m_versions[i]) continue;
+
+        m_versions[i] = m_instances[i]->GetVersion();
+        m_bounds[i] = m_instances[i]->GetWorldBounds();
+
+        // Gaining or losing bounds changes the tree membership
+        if (m_bounds[i].IsEmpty() != (m_leafOf[i] == ~0u)){
+            Build();
+            return;
+        }
+
+        if (m_leafOf[i] == ~0u) continue;
+
+        // Refit the leaf, then every ancestor up to the root
+        unsigned int index = m_leafOf[i];
+        Node& leaf = m_nodes[index];
+        leaf.bounds = AABB{};
+        for (unsigned int k{leaf.first}; k < leaf.first + leaf.count; ++k) leaf.bounds.Expand(m_bounds[m_order[k]]);
+
+        while (index != 0){
+            index = m_nodes[index].parent;
+            Node& node = m_nodes[index];
+            node.bounds = m_nodes[node.left].bounds;
+            node.bounds.Expand(m_nodes[node.left + 1].bounds);
+        }
+
+        moved = true;
+    }
+
+    // Refitting keeps the topology, rebuild once moving objects made it clearly worse
+    if (moved && ++m_refits % 64 == 0 && GetCost() > m_builtCost * 2.0f) Build();
+}
+
+void glWrap::Scene::Cull(const Frustum& frustum, std::vector<Instance*>& visible){
+    auto add = [&visible](Instance* instance){
+        if (instance->GetMesh() && instance->GetVisibility()) visible.push_back(instance);
+    };
+
+    for (Instance* instance : m_unbounded) add(instance);
+
+    if (m_nodes.empty()) return;
+
+    unsigned int stack[64];
+    int size{};
+    stack[size++] = 0;
+
+    while (size){
+        const Node& node = m_nodes[stack[--size]];
+
+        int side = frustum.Classify(node.bounds);
+        if (side < 0) continue;
+
+        if (side > 0){ // Fully inside, take the whole range without further tests
+            for (unsigned int i{node.first}; i < node.first + node.count; ++i) add(m_instances[m_order[i]]);
+        }
+        else if (!node.left){
+            for (unsigned int i{node.first}; i < node.first + node.count; ++i){
+                if (frustum.Intersects(m_bounds[m_order[i]])) add(m_instances[m_order[i]]);
+            }
+        }
+        else if (size + 2 <= 64){
+            stack[size++] = node.left;
+            stack[size++] = node.left + 1;
+        }
+        else { // Out of stack, accept the subtree
+            for (unsigned int i{node.first}; i < node.first + node.count; ++i) add(m_instances[m_order[i]]);
+        }
+    }
+}
+
+glWrap::Instance* glWrap::Scene::Raycast(glm::vec3 origin, glm::vec3 direction, float* distance){
+    direction = glm::normalize(direction);
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    Instance* hit{nullptr};
+    float closest = std::numeric_limits<float>::max();
+
+    auto testInstance = [&](Instance* instance){
+        Mesh* mesh = instance->GetMesh();
+        if (!mesh || IntersectRay(instance->GetWorldBounds(), origin, inverseDirection, closest) < 0.0f) return;
+
+        // Triangles are tested in mesh space, where the ray parameter matches the world distance
+        glm::mat4 inverse = glm::inverse(instance->GetTransformMatrix());
+        glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+        glm::vec3 localDirection = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+
+        for (const Primitive& primitive : mesh->m_primitives){
+            for (size_t i{}; i + 2 < primitive.m_indices.size(); i += 3){
+                float t = IntersectTriangle(localOrigin, localDirection,
+                    primitive.m_vertices[primitive.m_indices[i]].pos,
+                    primitive.m_vertices[primitive.m_indices[i + 1]].pos,
+                    primitive.m_vertices[primitive.m_indices[i + 2]].pos);
+
+                if (t >= 0.0f && t < closest){
+                    closest = t;
+                    hit = instance;
+                }
+            }
+        }
+    };
+
+    for (Instance* instance : m_unbounded) testInstance(instance);
+
+    if (!m_nodes.empty()){
+        unsigned int stack[64];
+        int size{};
+        stack[size++] = 0;
+
+        while (size){
+            const Node& node = m_nodes[stack[--size]];
+            if (IntersectRay(node.bounds, origin, inverseDirection, closest) < 0.0f) continue;
+
+            if (!node.left || size + 2 > 64){
+                for (unsigned int i{node.first}; i < node.first + node.count; ++i) testInstance(m_instances[m_order[i]]);
+            }
+            else {
+                stack[size++] = node.left;
+                stack[size++] = node.left + 1;
+            }
+        }
+    }
+
+    if (hit && distance) *distance = closest;
+    return hit;
+}
+
+// 
+// *Occlusion
+// 
+
+glWrap::OcclusionBuffer::OcclusionBuffer(glm::ivec2 size, JobSystem* jobs){
+    m_tiles = {(size.x + tileWidth - 1) / tileWidth, (size.y + tileHeight - 1) / tileHeight};
+    m_size = {m_tiles.x * tileWidth, m_tiles.y * tileHeight};
+    m_jobs = jobs ? jobs : &JobSystem::Default();
+
+    m_depth.resize(m_size.x * m_size.y);
+    m_tileMax.resize(m_tiles.x * m_tiles.y);
+    m_bins.resize(m_tiles.x * m_tiles.y);
+}
+
+void glWrap::OcclusionBuffer::Clear(const glm::mat4& viewProjection){
+    m_viewProjection = viewProjection;
+    m_triangles.clear();
+
+    for (std::vector<unsigned int>& bin : m_bins) bin.clear();
+}
+
+void glWrap::OcclusionBuffer::AddOccluder(const Mesh& mesh, const glm::mat4& transform){
+    glm::mat4 matrix = m_viewProjection * transform;
+    std::vector<glm::vec4> clip;
+
+    for (const Primitive& primitive : mesh.m_primitives){
+        clip.resize(primitive.m_vertices.size());
+
+        for (size_t i{}; i < clip.size(); ++i) clip[i] = matrix * glm::vec4(primitive.m_vertices[i].pos, 1.0f);
+
+        for (size_t i{}; i + 2 < primitive.m_indices.size(); i += 3){
+            AddTriangle(clip[primitive.m_indices[i]], clip[primitive.m_indices[i + 1]], clip[primitive.m_indices[i + 2]]);
+        }
+    }
+}
+
+void glWrap::OcclusionBuffer::AddTriangle(glm::vec4 a, glm::vec4 b, glm::vec4 c){
+    // Clip against the near plane (z > -w) in homogeneous space, giving up to two triangles
+    glm::vec4 input[3] = {a, b, c};
+    glm::vec4 polygon[4];
+    int count{};
+
+    for (int i{}; i < 3; ++i){
+        const glm::vec4& current = input[i];
+        const glm::vec4& next = input[(i + 1) % 3];
+        float currentDistance = current.z + current.w;
+        float nextDistance = next.z + next.w;
+
+        if (currentDistance >= 0.0f) polygon[count++] = current;
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)){
+            polygon[count++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+        }
+    }
+
+    for (int i{1}; i + 1 < count; ++i){
+        ScreenTriangle triangle;
+        glm::vec4 corners[3] = {polygon[0], polygon[i], polygon[i + 1]};
+        glm::vec2 low{std::numeric_limits<float>::max()}, high{-std::numeric_limits<float>::max()};
+
+        for (int k{}; k < 3; ++k){
+            glm::vec3 ndc = glm::vec3(corners[k]) / std::max(corners[k].w, 1e-6f);
+            triangle.v[k] = {(ndc.x * 0.5f + 0.5f) * m_size.x, (ndc.y * 0.5f + 0.5f) * m_size.y, ndc.z * 0.5f + 0.5f};
+            low = glm::min(low, glm::vec2(triangle.v[k]));
+            high = glm::max(high, glm::vec2(triangle.v[k]));
+        }
+
+        glm::ivec2 first = glm::clamp(glm::ivec2(glm::floor(low)) / glm::ivec2(tileWidth, tileHeight), glm::ivec2(0), m_tiles - 1);
+        glm::ivec2 last = glm::clamp(glm::ivec2(glm::floor(high)) / glm::ivec2(tileWidth, tileHeight), glm::ivec2(0), m_tiles - 1);
+
+        if (high.x < 0.0f || high.y < 0.0f || low.x >= m_size.x || low.y >= m_size.y) continue;
+
+        unsigned int index = m_triangles.size();
+        m_triangles.push_back(triangle);
+
+        for (int y{first.y}; y <= last.y; ++y){
+            for (int x{first.x}; x <= last.x; ++x) m_bins[y * m_tiles.x + x].push_back(index);
+        }
+    }
+}
+
+void glWrap::OcclusionBuffer::RasterizeTile(unsigned int tile){
+    glm::ivec2 origin = {(tile % m_tiles.x) * tileWidth, (tile / m_tiles.x) * tileHeight};
+
+    for (int y{}; y < tileHeight; ++y){
+        std::fill_n(&m_depth[(origin.y + y) * m_size.x + origin.x], tileWidth, 1.0f);
+    }
+
+    for (unsigned int index : m_bins[tile]){
+        const ScreenTriangle& triangle = m_triangles[index];
+        glm::vec3 a = triangle.v[0], b = triangle.v[1], c = triangle.v[2];
+
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::abs(area) < 1e-8f) continue;
+        if (area < 0.0f){ // Both windings occlude, make the edge functions positive inside
+            std::swap(b, c);
+            area = -area;
+        }
+
+        // Edge functions and the depth plane in the form e = A * x + B * y + C
+        glm::vec3 edgeA = {a.y - b.y, b.y - c.y, c.y - a.y};
+        glm::vec3 edgeB = {b.x - a.x, c.x - b.x, a.x - c.x};
+        glm::vec3 edgeC = {a.x * b.y - a.y * b.x, b.x * c.y - b.y * c.x, c.x * a.y - c.y * a.x};
+
+        float depthA = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+        float depthB = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+        float depthC = a.z - depthA * a.x - depthB * a.y;
+
+        int minX = std::max(origin.x, (int)std::floor(std::min({a.x, b.x, c.x})));
+        int maxX = std::min(origin.x + tileWidth - 1, (int)std::ceil(std::max({a.x, b.x, c.x})));
+        int minY = std::max(origin.y, (int)std::floor(std::min({a.y, b.y, c.y})));
+        int maxY = std::min(origin.y + tileHeight - 1, (int)std::ceil(std::max({a.y, b.y, c.y})));
+
+        minX &= ~3; // Four pixel aligned spans
+
+        for (int y{minY}; y <= maxY; ++y){
+            float py = y + 0.5f;
+            float* row = &m_depth[y * m_size.x];
+
+#if defined(GW_SIMD_AVX) || defined(GW_SIMD_SSE)
+            __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+
+            for (int x{minX}; x <= maxX; x += 4){
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA.x), px), _mm_set1_ps(edgeB.x * py + edgeC.x));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA.y), px), _mm_set1_ps(edgeB.y * py + edgeC.y));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA.z), px), _mm_set1_ps(edgeB.z * py + edgeC.z));
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+
+                if (!_mm_movemask_ps(inside)) continue;
+
+                __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), px), _mm_set1_ps(depthB * py + depthC));
+                __m128 stored = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(stored, depth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+            }
+#else
+            for (int x{minX}; x <= maxX; ++x){
+                float px = x + 0.5f;
+                if (edgeA.x * px + edgeB.x * py + edgeC.x < 0.0f) continue;
+                if (edgeA.y * px + edgeB.y * py + edgeC.y < 0.0f) continue;
+                if (edgeA.z * px + edgeB.z * py + edgeC.z < 0.0f) continue;
+
+                row[x] = std::min(row[x], depthA * px + depthB * py + depthC);
+            }
+#endif
+        }
+    }
+
+    float farthest{};
+    for (int y{}; y < tileHeight; ++y){
+        const float* row = &m_depth[(origin.y + y) * m_size.x + origin.x];
+        farthest = std::max(farthest, *std::max_element(row, row + tileWidth));
+    }
+
+    m_tileMax[tile] = farthest;
+}
+
+void glWrap::OcclusionBuffer::Rasterize(){
+    auto start = std::chrono::steady_clock::now();
+
+    m_jobs->ParallelFor(m_tiles.x * m_tiles.y, 1, [this](size_t begin, size_t end){
+        for (size_t tile{begin}; tile < end; ++tile) RasterizeTile((unsigned int)tile);
+    });
+
+    m_rasterTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool glWrap::OcclusionBuffer::IsVisible(const AABB& box) const {
+    if (box.IsEmpty()) return true;
+
+    glm::vec2 low{std::numeric_limits<float>::max()}, high{-std::numeric_limits<float>::max()};
+    float nearest = 1.0f;
+
+    for (int corner{}; corner < 8; ++corner){
+        glm::vec3 point = {corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z};
+        glm::vec4 clip = m_viewProjection * glm::vec4(point, 1.0f);
+
+        if (clip.z < -clip.w) return true; // Crosses the near plane
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        low = glm::min(low, glm::vec2((ndc.x * 0.5f + 0.5f) * m_size.x, (ndc.y * 0.5f + 0.5f) * m_size.y));
+        high = glm::max(high, glm::vec2((ndc.x * 0.5f + 0.5f) * m_size.x, (ndc.y * 0.5f + 0.5f) * m_size.y));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+
+    glm::ivec2 first = glm::max(glm::ivec2(glm::floor(low)), glm::ivec2(0));
+    glm::ivec2 last = glm::min(glm::ivec2(glm::floor(high)), m_size - 1);
+
+    if (first.x > last.x || first.y > last.y) return true; // Off screen, left to the frustum test
+
+    for (int tileY{first.y / tileHeight}; tileY <= last.y / tileHeight; ++tileY){
+        for (int tileX{first.x / tileWidth}; tileX <= last.x / tileWidth; ++tileX){
+
+            // Behind the farthest depth of the whole tile, nothing to check per pixel
+            if (nearest > m_tileMax[tileY * m_tiles.x + tileX]) continue;
+
+            int endY = std::min(last.y, tileY * tileHeight + tileHeight - 1);
+            int endX = std::min(last.x, tileX * tileWidth + tileWidth - 1);
+
+            for (int y{std::max(first.y, tileY * tileHeight)}; y <= endY; ++y){
+                for (int x{std::max(first.x, tileX * tileWidth)}; x <= endX; ++x){
+                    if (nearest <= m_depth[y * m_size.x + x]) return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+double glWrap::OcclusionBuffer::GetRasterTime(){ return m_rasterTime; }
+glm::ivec2 glWrap::OcclusionBuffer::GetSize(){ return m_size; }
+const std::vector<float>& glWrap::OcclusionBuffer::GetDepth(){ return m_depth; }
+
+// 
+// *Command buffer
+// 
+
+void glWrap::CommandBuffer::UseShader(Shader* shader){ m_commands.push_back({Op::UseShader, -1, shader, 0, 0}); }
+
+void glWrap::CommandBuffer::SetInt(int slot, int value){
+    // The bits are stored, a float only holds integers up to 2^24 exactly
+    float bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    m_commands.push_back({Op::SetInt, slot, nullptr, (unsigned int)m_values.size(), 1});
+    m_values.push_back(bits);
+}
+
+void glWrap::CommandBuffer::SetFloat(int slot, float value){
+    m_commands.push_back({Op::SetFloat, slot, nullptr, (unsigned int)m_values.size(), 1});
+    m_values.push_back(value);
+}
+
+void glWrap::CommandBuffer::SetVec4(int slot, glm::vec4 value){
+    m_commands.push_back({Op::SetVec4, slot, nullptr, (unsigned int)m_values.size(), 4});
+    m_values.insert(m_values.end(), glm::value_ptr(value), glm::value_ptr(value) + 4);
+}
+
+void glWrap::CommandBuffer::SetMatrix4(int slot, const glm::mat4& value){
+    m_commands.push_back({Op::SetMatrix4, slot, nullptr, (unsigned int)m_values.size(), 16});
+    m_values.insert(m_values.end(), glm::value_ptr(value), glm::value_ptr(value) + 16);
+}
+
+void glWrap::CommandBuffer::BindTexture(unsigned int unit, Texture2D* texture){ m_commands.push_back({Op::BindTexture, (int)unit, texture, 0, 0}); }
+void glWrap::CommandBuffer::BindTexture(unsigned int unit, Texture2DArray* texture){ m_commands.push_back({Op::BindTextureArray, (int)unit, texture, 0, 0}); }
+
+void glWrap::CommandBuffer::Draw(Primitive* primitive, const glm::mat4* transforms, unsigned int count){
+    if (!count) return;
+
+    m_commands.push_back({Op::Draw, -1, primitive, (unsigned int)m_transforms.size(), count});
+    m_transforms.insert(m_transforms.end(), transforms, transforms + count);
+}
+
+void glWrap::CommandBuffer::SetOrder(int order){ m_order = order; }
+int glWrap::CommandBuffer::GetOrder() const { return m_order; }
+
+void glWrap::CommandBuffer::Clear(){
+    m_commands.clear();
+    m_values.clear();
+    m_transforms.clear();
+}
+
+bool glWrap::CommandBuffer::IsEmpty() const { return m_commands.empty(); }
+size_t glWrap::CommandBuffer::Size() const { return m_commands.size(); }
+const std::vector<glWrap::CommandBuffer::Command>& glWrap::CommandBuffer::GetCommands() const { return m_commands; }
+const std::vector<float>& glWrap::CommandBuffer::GetValues() const { return m_values; }
+const std::vector<glm::mat4>& glWrap::CommandBuffer::GetTransforms() const { return m_transforms; }
+
+// 
+// *GPU Culling
+// 
+
+// One invocation per instance primitive record, visible ones take a slot of their command's range
+const char *cullComputeShader = "#version 430 core\n"
+"layout (local_size_x = 64) in;\n"
+"layout (std430, binding = 0) readonly buffer Records { uvec2 records[]; };\n"
+"layout (std430, binding = 1) readonly buffer Bounds { vec4 bounds[]; };\n"
+"layout (std430, binding = 2) readonly buffer Models { mat4 models[]; };\n"
+"layout (std430, binding = 3) buffer Commands { uint commands[]; };\n"
+"layout (std430, binding = 4) writeonly buffer Visible { mat4 visible[]; };\n"
+"uniform vec4 planes[6];\n"
+"uniform mat4 viewProjection;\n"
+"uniform uint recordCount;\n"
+"uniform bool useHiZ;\n"
+"uniform sampler2D hiZ;\n"
+"uniform mat4 hiZViewProjection;\n"
+"uniform vec2 hiZSize;\n"
+"uniform int hiZLevels;\n"
+"bool Occluded(vec3 center, vec3 extent)\n"
+"{\n"
+"    vec2 low = vec2(1.0), high = vec2(0.0);\n"
+"    float nearest = 1.0;\n"
+"    for (int i = 0; i < 8; ++i) {\n"
+"        vec3 corner = center + extent * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);\n"
+"        vec4 clip = hiZViewProjection * vec4(corner, 1.0);\n"
+"        if (clip.w <= 0.0 || clip.z < -clip.w) return false;\n"
+"        vec3 ndc = clip.xyz / clip.w;\n"
+"        low = min(low, ndc.xy * 0.5 + 0.5);\n"
+"        high = max(high, ndc.xy * 0.5 + 0.5);\n"
+"        nearest = min(nearest, ndc.z * 0.5 + 0.5);\n"
+"    }\n"
+"    low = clamp(low, 0.0, 1.0);\n"
+"    high = clamp(high, 0.0, 1.0);\n"
+"    vec2 size = (high - low) * hiZSize;\n"
+"    float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, float(hiZLevels - 1));\n"
+"    float farthest = max(max(textureLod(hiZ, low, level).r, textureLod(hiZ, vec2(high.x, low.y), level).r),\n"
+"                         max(textureLod(hiZ, vec2(low.x, high.y), level).r, textureLod(hiZ, high, level).r));\n"
+"    return nearest > farthest;\n"
+"}\n"
+"void main()\n"
+"{\n"
+"    uint id = gl_GlobalInvocationID.x + gl_GlobalInvocationID.y * gl_NumWorkGroups.x * 64u;\n"
+"    if (id >= recordCount) return;\n"
+"    uvec2 record = records[id];\n"
+"    vec3 center = bounds[record.x * 2u].xyz;\n"
+"    vec4 extent = bounds[record.x * 2u + 1u];\n"
+"    if (extent.w < 0.0) return;\n"
+"    if (extent.w == 0.0) {\n"
+"        for (int i = 0; i < 6; ++i) {\n"
+"            if (dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), extent.xyz) < 0.0) return;\n"
+"        }\n"
+"        if (useHiZ && Occluded(center, extent.xyz)) return;\n"
+"    }\n"
+"    uint slot = atomicAdd(commands[record.y * 5u + 1u], 1u);\n"
+"    visible[commands[record.y * 5u + 4u] + slot] = viewProjection * models[record.x];\n"
+"}\n";
+
+// Farthest depth of every 2x2 block of the level above, odd edges fold in the extra row or column
+const char *pyramidComputeShader = "#version 430 core\n"
+"layout (local_size_x = 8, local_size_y = 8) in;\n"
+"layout (r32f, binding = 0) writeonly uniform image2D destination;\n"
+"layout (r32f, binding = 1) readonly uniform image2D source;\n"
+"uniform sampler2D depth;\n"
+"uniform bool copyDepth;\n"
+"uniform ivec2 sourceSize;\n"
+"void main()\n"
+"{\n"
+"    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+"    ivec2 size = imageSize(destination);\n"
+"    if (any(greaterThanEqual(texel, size))) return;\n"
+"    if (copyDepth) {\n"
+"        imageStore(destination, texel, vec4(texelFetch(depth, texel, 0).r));\n"
+"        return;\n"
+"    }\n"
+"    int countX = (texel.x == size.x - 1 && (sourceSize.x & 1) == 1) ? 3 : 2;\n"
+"    int countY = (texel.y == size.y - 1 && (sourceSize.y & 1) == 1) ? 3 : 2;\n"
+"    float farthest = 0.0;\n"
+"    for (int y = 0; y < countY; ++y) {\n"
+"        for (int x = 0; x < countX; ++x) {\n"
+"            farthest = max(farthest, imageLoad(source, min(texel * 2 + ivec2(x, y), sourceSize - 1)).r);\n"
+"        }\n"
+"    }\n"
+"    imageStore(destination, texel, vec4(farthest));\n"
+"}\n";
+
+static GLuint CreateComputeProgram(const char* source){
+    return glWrap::ProgramCache::Link({{GL_COMPUTE_SHADER, source}});
+}
+
+static void MirrorInstance(glWrap::Instance* instance, glm::mat4& model, glm::vec4* bounds){
+    const glWrap::AABB& box = instance->GetWorldBounds();
+    model = instance->GetTransformMatrix();
+
+    // Extent w: -1 hidden, 1 without bounds so never culled, 0 tested
+    float flag = !instance->GetVisibility() ? -1.0f : box.IsEmpty() ? 1.0f : 0.0f;
+    bounds[0] = glm::vec4(box.IsEmpty() ? glm::vec3(0.0f) : box.GetCenter(), 0.0f);
+    bounds[1] = glm::vec4(box.IsEmpty() ? glm::vec3(0.0f) : box.GetExtent(), flag);
+}
+
+glWrap::GpuCulling::GpuCulling(){
+    m_cullProgram = CreateComputeProgram(cullComputeShader);
+    m_pyramidProgram = CreateComputeProgram(pyramidComputeShader);
+
+    glGenBuffers(1, &m_recordBuffer);
+    glGenBuffers(1, &m_boundsBuffer);
+    glGenBuffers(1, &m_modelBuffer);
+    glGenBuffers(1, &m_commandBuffer);
+    glGenBuffers(1, &m_visibleBuffer);
+}
+
+glWrap::GpuCulling::~GpuCulling(){
+    StateCache& state = StateCache::Current();
+    state.DeleteProgram(m_cullProgram);
+    state.DeleteProgram(m_pyramidProgram);
+    state.DeleteBuffer(m_recordBuffer);
+    state.DeleteBuffer(m_boundsBuffer);
+    state.DeleteBuffer(m_modelBuffer);
+    state.DeleteBuffer(m_commandBuffer);
+    state.DeleteBuffer(m_visibleBuffer);
+    if (m_hiZ) state.DeleteTexture(m_hiZ);
+}
+
+void glWrap::GpuCulling::Build(Scene& scene, Shader* defaultShader){
+    const std::vector<Instance*>& instances = scene.GetInstances();
+
+    m_scene = &scene;
+    m_generation = scene.GetGeneration();
+    m_mirrored.clear();
+    m_fallback.clear();
+    m_commands.clear();
+    m_groups.clear();
+    m_models.assign(instances.size(), glm::mat4(1.0f));
+    m_bounds.assign(instances.size() * 2, glm::vec4(0.0f));
+    m_versions.assign(instances.size(), 0);
+
+    struct Record{
+        Shader*         shader;
+        Primitive*      primitive;
+        unsigned int    instance;
+    };
+
+    std::vector<Record> records;
+
+    for (unsigned int i{}; i < instances.size(); ++i){
+        Instance* instance = instances[i];
+        Mesh* mesh = instance->GetMesh();
+        if (!mesh) continue;
+
+        // Blending needs back to front order and unpooled primitives can't be multi-drawn
+        bool drawable = true;
+        for (int p{}; p < mesh->m_primitives.size(); ++p){
+            Shader* shader = instance->GetShader(p) ? instance->GetShader(p) : defaultShader;
+            if (shader->IsTransparent() || mesh->m_primitives[p].m_baseVertex < 0) drawable = false;
+        }
+
+        if (!drawable){
+            m_fallback.push_back(instance);
+            continue;
+        }
+
+        for (int p{}; p < mesh->m_primitives.size(); ++p){
+            records.push_back({instance->GetShader(p) ? instance->GetShader(p) : defaultShader, &mesh->m_primitives[p], i});
+        }
+
+        m_mirrored.push_back(i);
+        MirrorInstance(instance, m_models[i], &m_bounds[i * 2]);
+        m_versions[i] = instance->GetVersion();
+    }
+
+    std::sort(records.begin(), records.end(), [](const Record& a, const Record& b){
+        if (a.shader->GetID() != b.shader->GetID()) return a.shader->GetID() < b.shader->GetID();
+        return a.primitive < b.primitive;
+    });
+
+    // A command per shader and primitive pair, its instance range holds every record it could draw
+    std::vector<glm::uvec2> packed;
+    packed.reserve(records.size());
+
+    for (size_t i{}; i < records.size(); ++i){
+        const Record& record = records[i];
+
+        if (i == 0 || record.shader != records[i - 1].shader || record.primitive != records[i - 1].primitive){
+            if (m_groups.empty() || m_groups.back().shader != record.shader) m_groups.push_back({record.shader, (unsigned int)m_commands.size(), 0});
+
+            Primitive* primitive = record.primitive;
+            m_commands.push_back({(GLuint)primitive->m_indices.size(), 0, primitive->m_firstIndex, primitive->m_baseVertex, (GLuint)i});
+            ++m_groups.back().count;
+        }
+
+        packed.push_back({record.instance, (unsigned int)m_commands.size() - 1});
+    }
+
+    m_recordCount = packed.size();
+
+    StateCache& state = StateCache::Current();
+    state.BindBuffer(GL_ARRAY_BUFFER, m_recordBuffer);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(glm::uvec2), packed.data(), GL_STATIC_DRAW);
+    state.BindBuffer(GL_ARRAY_BUFFER, m_boundsBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_bounds.size() * sizeof(glm::vec4), m_bounds.data(), GL_DYNAMIC_DRAW);
+    state.BindBuffer(GL_ARRAY_BUFFER, m_modelBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_models.size() * sizeof(glm::mat4), m_models.data(), GL_DYNAMIC_DRAW);
+    state.BindBuffer(GL_ARRAY_BUFFER, m_commandBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_commands.size() * sizeof(DrawCommand), m_commands.data(), GL_DYNAMIC_DRAW);
+    state.BindBuffer(GL_ARRAY_BUFFER, m_visibleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(glm::mat4), nullptr, GL_DYNAMIC_COPY);
+}
+
+void glWrap::GpuCulling::Prepare(Scene& scene, Shader* defaultShader, std::vector<Instance*>& fallback){
+    if (m_scene != &scene || m_generation != scene.GetGeneration()){
+        Build(scene, defaultShader);
+    }
+    else {
+        const std::vector<Instance*>& instances = scene.GetInstances();
+        size_t low{instances.size()}, high{};
+
+        // Static instances don't move, but hiding one bumps its version too
+        for (unsigned int i : m_mirrored){
+            if (instances[i]->GetVersion() == m_versions[i]) continue;
+
+            MirrorInstance(instances[i], m_models[i], &m_bounds[i * 2]);
+            m_versions[i] = instances[i]->GetVersion();
+            low = std::min<size_t>(low, i);
+            high = std::max<size_t>(high, i);
+        }
+
+        // One upload covering every changed instance
+        if (low <= high){
+            StateCache& state = StateCache::Current();
+            state.BindBuffer(GL_ARRAY_BUFFER, m_modelBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, low * sizeof(glm::mat4), (high - low + 1) * sizeof(glm::mat4), &m_models[low]);
+            state.BindBuffer(GL_ARRAY_BUFFER, m_boundsBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, low * 2 * sizeof(glm::vec4), (high - low + 1) * 2 * sizeof(glm::vec4), &m_bounds[low * 2]);
+        }
+    }
+
+    for (Instance* instance : m_fallback){
+        if (instance->GetVisibility()) fallback.push_back(instance);
+    }
+}
+
+void glWrap::GpuCulling::Dispatch(const Frustum& frustum, const glm::mat4& viewProjection){
+    if (!m_recordCount) return;
+
+    StateCache& state = StateCache::Current();
+
+    // Zero the instance counts, the only per frame upload besides moved instances
+    state.BindBuffer(GL_ARRAY_BUFFER, m_commandBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_commands.size() * sizeof(DrawCommand), m_commands.data());
+
+    state.UseProgram(m_cullProgram);
+    glUniform4fv(glGetUniformLocation(m_cullProgram, "planes"), 6, glm::value_ptr(frustum.GetPlanes()[0]));
+    glUniformMatrix4fv(glGetUniformLocation(m_cullProgram, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    glUniform1ui(glGetUniformLocation(m_cullProgram, "recordCount"), m_recordCount);
+    glUniform1i(glGetUniformLocation(m_cullProgram, "useHiZ"), m_hiZValid);
+
+    if (m_hiZValid){
+        state.BindTexture(0, GL_TEXTURE_2D, m_hiZ);
+        state.BindSampler(0, 0); // Sampled with its own mip filter
+        glUniform1i(glGetUniformLocation(m_cullProgram, "hiZ"), 0);
+        glUniformMatrix4fv(glGetUniformLocation(m_cullProgram, "hiZViewProjection"), 1, GL_FALSE, glm::value_ptr(m_hiZViewProjection));
+        glUniform2f(glGetUniformLocation(m_cullProgram, "hiZSize"), (float)m_depthSize.x, (float)m_depthSize.y);
+        glUniform1i(glGetUniformLocation(m_cullProgram, "hiZLevels"), m_hiZLevels);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_recordBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_modelBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_visibleBuffer);
+
+    // Work group counts are limited to 65535 per dimension, larger scenes spill into y
+    GLuint groups = (m_recordCount + 63) / 64;
+    GLuint rows = (groups + 65534) / 65535;
+    glDispatchCompute((groups + rows - 1) / rows, rows, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+unsigned int glWrap::GpuCulling::Draw(GeometryPool& geometry, Shader*& currentShader){
+    if (!m_recordCount) return 0;
+
+    StateCache& state = StateCache::Current();
+    geometry.Bind(m_visibleBuffer);
+    state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+
+    for (Group& group : m_groups){
+        if (currentShader != group.shader){
+            currentShader = group.shader;
+            currentShader->Use();
+            currentShader->Update();
+        }
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)(group.first * sizeof(DrawCommand)), group.count, 0);
+    }
+
+    return m_groups.size();
+}
+
+void glWrap::GpuCulling::SetDepthSource(GLuint depthTexture, glm::ivec2 size){
+    StateCache& state = StateCache::Current();
+
+    m_depthSource = depthTexture;
+    m_hiZValid = false;
+
+    if (m_hiZ){
+        state.DeleteTexture(m_hiZ);
+        m_hiZ = 0;
+    }
+
+    if (!depthTexture) return;
+
+    m_depthSize = size;
+    m_hiZLevels = 1 + (int)std::floor(std::log2((float)std::max(size.x, size.y)));
+
+    glGenTextures(1, &m_hiZ);
+    state.BindTexture(0, GL_TEXTURE_2D, m_hiZ);
+
+    for (int level{}; level < m_hiZLevels; ++level){
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, size.x, size.y, 0, GL_RED, GL_FLOAT, nullptr);
+        size = glm::max(size / 2, glm::ivec2(1));
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_hiZLevels - 1);
+}
+
+void glWrap::GpuCulling::BuildHiZ(const glm::mat4& viewProjection){
+    if (!m_depthSource) return;
+
+    StateCache& state = StateCache::Current();
+    state.UseProgram(m_pyramidProgram);
+    state.BindTexture(0, GL_TEXTURE_2D, m_depthSource);
+    glUniform1i(glGetUniformLocation(m_pyramidProgram, "depth"), 0);
+
+    GLint copyDepth = glGetUniformLocation(m_pyramidProgram, "copyDepth");
+    GLint sourceSize = glGetUniformLocation(m_pyramidProgram, "sourceSize");
+    glm::ivec2 source = m_depthSize, size = m_depthSize;
+
+    for (int level{}; level < m_hiZLevels; ++level){
+        glUniform1i(copyDepth, level == 0);
+        glUniform2i(sourceSize, source.x, source.y);
+
+        glBindImageTexture(0, m_hiZ, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        if (level) glBindImageTexture(1, m_hiZ, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+
+        glDispatchCompute((size.x + 7) / 8, (size.y + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        source = size;
+        size = glm::max(size / 2, glm::ivec2(1));
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    m_hiZViewProjection = viewProjection;
+    m_hiZValid = true;
+}
+
+unsigned int glWrap::GpuCulling::GetRecordCount(){ return m_recordCount; }
+
+// 
+// *Window
+// 
+
+std::vector<unsigned int> glWrap::Window::m_pressedKeys;
+std::vector<unsigned int> glWrap::Window::m_releasedKeys;
+std::vector<unsigned int> glWrap::Window::m_repeatKeys;
+glm::dvec2 glWrap::Window::m_lastMousePos;
+glm::dvec2 glWrap::Window::m_deltaMousePos;
+glm::ivec2 glWrap::Window::m_size;
+
+glWrap::Window::Window(std::string name, glm::ivec2 size) : m_name{name}, m_jobs{&JobSystem::Default()}{
+
+    if(!glfwInit()){
+        DEV_LOG("Failed to initialize OPENGL", "");
+        return;
+    }
+
+    // Prefer a 4.3 context for the multi-draw path, 3.3 is the required minimum
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    m_window = glfwCreateWindow(size.x, size.y, name.c_str(), NULL, NULL);
+
+    if (!m_window){
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        m_window = glfwCreateWindow(size.x, size.y, name.c_str(), NULL, NULL);
+    }
+
+    glfwMakeContextCurrent(m_window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        DEV_LOG("Failed to initialize GLAD for window ", name);
+        glfwTerminate();
+    }
+
+    LoadEntryPoints();
+    m_multiDrawSupported = glMultiDrawElementsIndirect != nullptr;
+    m_multiDraw = m_multiDrawSupported;
+    m_computeSupported = m_multiDrawSupported && glDispatchCompute && glMemoryBarrier && glBindImageTexture;
+
+    StateCache::Current().Invalidate();
+    StateCache::Current().SetCapability(GL_DEPTH_TEST, true);
+
+    m_defaultShader = std::make_unique<Shader>(defaultVertexShader, defaultFragmentShader, true);
+    m_size = size;
+
+    glGenBuffers(1, &m_instanceVBO);
+    if (m_multiDrawSupported) glGenBuffers(1, &m_indirectBuffer);
+
+    glfwSetKeyCallback(m_window, keyCall);
+    glfwSetFramebufferSizeCallback(m_window, frameCall);
+    // glfwSetCursorPosCallback(m_window, mousePosCall);
+    glfwGetCursorPos(m_window, &m_lastMousePos.x, &m_lastMousePos.y);
+}
+
+/*
+glWrap::Window::Window(std::string name, glm::ivec2 size, GLFWwindow* context) : m_name{name}{
+
+    m_window = glfwCreateWindow(size.x, size.y, name.c_str(), NULL, context);
+
+    glfwMakeContextCurrent(m_window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        DEV_LOG("Failed to initialize GLAD for window ", name);
+        glfwTerminate();
+    }
+
+    glEnable(GL_DEPTH_TEST);
+
+    m_defaultShader = std::make_unique<Shader>(defaultVertexShader, defaultFragmentShader, true);
+    m_lastMousePos = { (size.x / 2), (size.y / 2) };
+    m_size = size;
+
+    glfwSetKeyCallback(m_window, keyCall);
+    glfwSetFramebufferSizeCallback(m_window, frameCall);
+    // glfwSetCursorPosCallback(m_window, mousePosCall);
+    glfwGetCursorPos(m_window, &m_lastMousePos.x, &m_lastMousePos.y);
+}
+*/
+
+void glWrap::Window::Swap(){
+
+    if (m_renderThread.joinable()){
+        Publish();
+    }
+    else {
+        PollUploads();
+        m_textureLoader.Update();
+        m_textureStreamer.Update();
+        m_textureCache.Collect();
+        Flush();
+
+        glfwSwapBuffers(m_window);
+        glClearColor(m_color.r, m_color.g, m_color.b, m_color.a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    m_pressedKeys.clear();
+    m_releasedKeys.clear();
+    m_repeatKeys.clear();
+    glfwPollEvents();
+
+    glm::dvec2 pos;
+    glfwGetCursorPos(m_window, &pos.x, &pos.y);
+    m_deltaMousePos = { (pos.x - m_lastMousePos.x), (m_lastMousePos.y - pos.y) };
+    m_lastMousePos = pos;
+
+    m_deltaTime = glfwGetTime() - m_lastFrameTime;
+    m_lastFrameTime = glfwGetTime();
+
+    if (!m_firstFrame) return;
+    
+    m_deltaTime = 0.0f;
+    m_lastFrameTime = glfwGetTime();
+    m_firstFrame = false;
+}
+
+void glWrap::Window::Draw(Instance& instance){
+
+    if (instance.GetMesh() && instance.GetVisibility() && m_ActiveCamera){
+        m_drawQueue.push_back(&instance);
+    }
+}
+
+void glWrap::Window::Draw(Scene& scene){
+
+    if (!m_ActiveCamera) return;
+
+    // Mirrored and culled on the GPU at the next Flush, the render thread can't read the scene.
+    // The GPU mirrors one scene, later ones in the frame are culled here
+    if (m_gpuCulling && m_multiDraw && !m_renderThread.joinable() && (!m_gpuScene || m_gpuScene == &scene)){
+        m_gpuScene = &scene;
+        return;
+    }
+
+    scene.Update();
+
+    size_t queued = m_culledQueue.size();
+    scene.Cull(m_culling ? m_ActiveCamera->GetFrustum(m_size) : Frustum(), m_culledQueue);
+    m_sceneCulled += scene.Size() - (m_culledQueue.size() - queued);
+}
+
+void glWrap::Window::Flush(){
+
+    if (m_renderThread.joinable()) return;
+
+    Scene* gpuScene = m_gpuCulling ? m_gpuScene : nullptr;
+    m_gpuScene = nullptr;
+
+    if (m_drawQueue.empty() && m_culledQueue.empty() && m_commandBuffers.empty() && !gpuScene) return;
+
+    // Instances the GPU path can't draw join the queue
+    if (gpuScene) m_gpuCulling->Prepare(*gpuScene, m_defaultShader.get(), m_drawQueue);
+
+    FramePacket& frame = m_frame;
+    std::swap(frame.commandBuffers, m_commandBuffers);
+    frame.gpuScene = gpuScene;
+    frame.snapshot = false;
+    Gather(frame);
+
+    Render(frame);
+
+    frame.commandBuffers.clear();
+}
+
+void glWrap::Window::Gather(FramePacket& frame){
+    // Stale model matrices are composed in batches before they are copied
+    m_transformQueue.assign(m_drawQueue.begin(), m_drawQueue.end());
+    WorldObject::UpdateTransformMatrices(m_transformQueue.data(), m_transformQueue.size());
+
+    unsigned int shaders{};
+    m_shaderSlots.clear();
+
+    // Slots are reused across frames, so the copied uniform maps keep their nodes
+    auto slot = [&](Shader* shader){
+        auto found = m_shaderSlots.find(shader);
+        if (found != m_shaderSlots.end()) return found->second;
+
+        if (shaders == frame.shaders.size()) frame.shaders.emplace_back();
+        FrameShader& copy = frame.shaders[shaders];
+        copy.shader = shader;
+        copy.program = shader->GetID();
+        copy.textureKey = shader->GetTextureKey();
+        copy.transparent = shader->IsTransparent();
+
+        if (frame.snapshot){
+            copy.uniforms = shader->GetUniforms();
+            Shader::GetBindings(copy.uniforms, copy.bindings);
+        }
+
+        m_shaderSlots.insert({shader, shaders});
+        return shaders++;
+    };
+
+    frame.queued = m_drawQueue.size();
+    frame.draws.resize(m_drawQueue.size() + m_culledQueue.size());
+    frame.drawShaders.clear();
+
+    for (size_t i{}; i < frame.draws.size(); ++i){
+        Instance* instance = i < frame.queued ? m_drawQueue[i] : m_culledQueue[i - frame.queued];
+        FrameDraw& draw = frame.draws[i];
+
+        draw.matrix = instance->GetTransformMatrix();
+        draw.bounds = instance->GetWorldBounds();
+        draw.mesh = instance->GetMesh();
+        draw.occluder = instance->GetOccluder();
+        draw.shaders = (unsigned int)frame.drawShaders.size();
+
+        for (int p{}; p < draw.mesh->m_primitives.size(); ++p){
+            frame.drawShaders.push_back(slot(instance->GetShader(p) ? instance->GetShader(p) : m_defaultShader.get()));
+        }
+    }
+
+    for (const CommandBuffer& buffer : frame.commandBuffers){
+        for (const CommandBuffer::Command& command : buffer.GetCommands()){
+            if (command.op == CommandBuffer::Op::UseShader) slot((Shader*)command.object);
+        }
+    }
+
+    frame.shaders.resize(shaders);
+
+    if (m_ActiveCamera){
+        frame.viewProjection = m_ActiveCamera->GetViewProjection(m_size);
+        frame.frustum = m_ActiveCamera->GetFrustum(m_size);
+        frame.cameraPosition = m_ActiveCamera->m_transform.pos;
+        frame.cameraForward = m_ActiveCamera->GetForwardVector();
+        frame.farClip = m_ActiveCamera->GetClip().y;
+        frame.projectionScale = m_ActiveCamera->GetProjection(m_size)[1][1] * m_size.y * 0.5f;
+        frame.perspective = m_ActiveCamera->IsPerspective();
+    }
+
+    frame.sceneCulled = m_sceneCulled;
+    frame.size = m_size;
+    frame.color = m_color;
+    frame.culling = m_culling;
+
+    m_drawQueue.clear();
+    m_culledQueue.clear();
+    m_sceneCulled = 0;
+}
+
+void glWrap::Window::Submit(CommandBuffer& buffer){
+    if (buffer.IsEmpty()) return;
+
+    m_commandBuffers.push_back(std::move(buffer));
+    buffer.Clear();
+}
+
+void glWrap::Window::Publish(){
+    FramePacket& frame = m_packets.GetBack();
+
+    // The render thread only sees copies, the caller is free to change everything once this returns
+    frame.commandBuffers.swap(m_commandBuffers);
+    m_commandBuffers.clear();
+    frame.gpuScene = nullptr;
+    frame.snapshot = true;
+    Gather(frame);
+
+    m_packets.Publish();
+
+    // Locked once so the render thread can't miss the wake between checking and sleeping
+    { std::lock_guard<std::mutex> lock(m_packetMutex); }
+    m_packetReady.notify_one();
+}
+
+void glWrap::Window::RenderLoop(){
+    glfwMakeContextCurrent(m_window);
+    StateCache::Current().Invalidate();
+
+    while (m_rendering.load(std::memory_order_acquire)){
+        if (!m_packets.Acquire()){
+            std::unique_lock<std::mutex> lock(m_packetMutex);
+            m_packetReady.wait(lock, [this]{ return m_packets.IsPending() || !m_rendering.load(std::memory_order_acquire); });
+            continue;
+        }
+
+        FramePacket& frame = m_packets.GetFront();
+        StateCache::Current().SetViewport({0, 0, frame.size.x, frame.size.y});
+
+        // The only per-frame work safe here, the loader, streamer and uploads are refused while threaded
+        m_textureCache.DeleteReleased();
+
+        if (!frame.draws.empty() || !frame.commandBuffers.empty()) Render(frame);
+
+        glfwSwapBuffers(m_window);
+        glClearColor(frame.color.r, frame.color.g, frame.color.b, frame.color.a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    glFinish();
+    glfwMakeContextCurrent(nullptr);
+}
+
+static void UpdateUniforms(const glWrap::FramePacket& frame, const glWrap::FrameShader& shader){
+    // Snapshotted uniforms and texture names when the frame came from another thread
+    if (frame.snapshot) glWrap::Shader::Update(shader.program, shader.uniforms, shader.bindings.data());
+    else shader.shader->Update();
+}
+
+static const glWrap::FrameShader* FindShader(const glWrap::FramePacket& frame, const glWrap::Shader* shader){
+    for (const glWrap::FrameShader& copy : frame.shaders){
+        if (copy.shader == shader) return &copy;
+    }
+    return nullptr;
+}
+
+void glWrap::Window::Render(FramePacket& frame){
+
+    Scene* gpuScene = frame.gpuScene;
+    const glm::mat4& viewProjection = frame.viewProjection;
+    std::vector<FrameDraw>& draws = frame.draws;
+
+    unsigned int culled{frame.sceneCulled};
+
+    if (frame.culling){
+        const Frustum& frustum = frame.frustum;
+
+        m_cullBoxes.Clear();
+        for (size_t i{}; i < frame.queued; ++i) m_cullBoxes.Add(draws[i].bounds);
+
+        frustum.Cull(m_cullBoxes, m_cullResults, *m_jobs);
+
+        // Draws a Scene already culled follow the queued ones and are kept
+        size_t kept{};
+        for (size_t i{}; i < draws.size(); ++i){
+            if (i >= frame.queued || m_cullResults[i]) draws[kept++] = draws[i];
+        }
+
+        culled += draws.size() - kept;
+        draws.resize(kept);
+    }
+
+    unsigned int occluded{};
+
+    if (m_occlusion){
+        m_occlusion->Clear(viewProjection);
+
+        for (const FrameDraw& draw : draws){
+            if (draw.occluder) m_occlusion->AddOccluder(*draw.occluder, draw.matrix);
+        }
+
+        m_occlusion->Rasterize();
+
+        m_cullResults.resize(draws.size());
+        m_jobs->ParallelFor(draws.size(), 1024, [&](size_t begin, size_t end){
+            for (size_t i{begin}; i < end; ++i) m_cullResults[i] = m_occlusion->IsVisible(draws[i].bounds);
+        });
+
+        // Occluders are drawn regardless, they would mostly test against their own depth
+        size_t kept{};
+        for (size_t i{}; i < draws.size(); ++i){
+            if (draws[i].occluder || m_cullResults[i]) draws[kept++] = draws[i];
+        }
+
+        occluded = draws.size() - kept;
+        draws.resize(kept);
+    }
+
+    std::vector<glm::mat4> transforms;
+    transforms.reserve(draws.size());
+    m_items.clear();
+
+    glm::vec3 cameraPos = frame.cameraPosition;
+    glm::vec3 cameraDir = frame.cameraForward;
+    float farClip = frame.farClip;
+
+    // The render thread can't reach the streamer, its shaders' textures may also differ from the packet's
+    if (m_textureStreamer.Size() && !frame.snapshot) RequireTextures(frame);
+
+    for (const FrameDraw& draw : draws){
+        transforms.push_back(draw.matrix);
+
+        float depth = glm::dot(glm::vec3(draw.matrix[3]) - cameraPos, cameraDir) / farClip;
+
+        for (int i{}; i < draw.mesh->m_primitives.size(); ++i){
+            const FrameShader* shader = &frame.shaders[frame.drawShaders[draw.shaders + i]];
+            Primitive* primitive = &draw.mesh->m_primitives[i];
+
+            uint64_t key = PackSortKey(shader->transparent, shader->program, shader->textureKey, primitive->m_VAO, depth);
+            m_items.push_back({key, shader, primitive, (unsigned int)transforms.size() - 1});
+        }
+    }
+
+    // Shaders only need the combined matrix
+    m_jobs->ParallelFor(transforms.size(), 4096, [&](size_t begin, size_t end){
+        for (size_t i{begin}; i < end; ++i) transforms[i] = viewProjection * transforms[i];
+    });
+
+    // Count the state changes drawing in caller order would have cost
+    unsigned int unsortedChanges{};
+    for (int i{}; i < m_items.size(); ++i){
+        if (i == 0 || m_items[i].shader != m_items[i - 1].shader) ++unsortedChanges;
+        if (i == 0 || m_items[i].shader->textureKey != m_items[i - 1].shader->textureKey) ++unsortedChanges;
+        if (i == 0 || m_items[i].primitive != m_items[i - 1].primitive) ++unsortedChanges;
+    }
+
+    RadixSort(m_items, m_sortScratch);
+
+    // Consecutive items drawing the same primitive with the same shader become one batch
+    m_batches.clear();
+    m_instanceData.clear();
+
+    for (const DrawItem& item : m_items){
+        if (m_batches.empty() || m_batches.back().shader != item.shader || m_batches.back().primitive != item.primitive){
+            m_batches.push_back({item.shader, item.primitive, (unsigned int)m_instanceData.size(), 0});
+        }
+
+        m_instanceData.push_back(transforms[item.transform]);
+        ++m_batches.back().count;
+    }
+
+    RenderStats stats{culled, occluded, (unsigned int)m_items.size(), 0, 0, 0};
+    m_currentShader = nullptr;
+
+    // The GPU culled scene is opaque, so it goes first
+    if (gpuScene){
+        m_gpuCulling->Dispatch(frame.culling ? frame.frustum : Frustum(), viewProjection);
+        stats.items += m_gpuCulling->GetRecordCount();
+        stats.drawCalls += m_gpuCulling->Draw(m_geometry, m_currentShader);
+    }
+
+    // Command buffer transforms follow the batches in the same upload
+    std::stable_sort(frame.commandBuffers.begin(), frame.commandBuffers.end(), [](const CommandBuffer& a, const CommandBuffer& b){ return a.GetOrder() < b.GetOrder(); });
+
+    std::vector<unsigned int> bases;
+    for (const CommandBuffer& buffer : frame.commandBuffers){
+        bases.push_back((unsigned int)m_instanceData.size());
+        for (const glm::mat4& transform : buffer.GetTransforms()) m_instanceData.push_back(viewProjection * transform);
+    }
+
+    // Orphan and refill the instance buffer once for the whole frame
+    StateCache& state = StateCache::Current();
+    state.BindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, m_instanceData.size() * sizeof(glm::mat4), m_instanceData.data(), GL_STREAM_DRAW);
+
+    // One indirect command per batch, a shader's pooled batches are then submitted together
+    if (m_multiDraw){
+        m_commands.clear();
+
+        for (InstanceBatch& batch : m_batches){
+            Primitive* primitive = batch.primitive;
+            m_commands.push_back({(GLuint)primitive->m_indices.size(), batch.count, primitive->m_firstIndex, primitive->m_baseVertex, batch.first});
+        }
+
+        state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawCommand), m_commands.data(), GL_STREAM_DRAW);
+    }
+
+    const void* currentGeometry{nullptr}; // The drawn primitive, or the pool when multi-drawing
+    const FrameShader* current{nullptr};
+    bool blending{false};
+
+    for (int i{}; i < m_batches.size();){
+        InstanceBatch& batch = m_batches[i];
+
+        if (batch.shader->transparent != blending){
+            blending = batch.shader->transparent;
+
+            state.SetCapability(GL_BLEND, blending);
+            state.SetDepthMask(!blending);
+            if (blending) state.SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+
+        // Uniforms don't change during a flush, so they are only sent when the program changes
+        if (m_currentShader != batch.shader->shader){
+            if (!current || current->textureKey != batch.shader->textureKey) ++stats.stateChanges;
+            ++stats.stateChanges;
+
+            current = batch.shader;
+            m_currentShader = current->shader;
+            state.UseProgram(current->program);
+            UpdateUniforms(frame, *current);
+        }
+
+        ++stats.drawCalls;
+
+        if (m_multiDraw && batch.primitive->m_baseVertex >= 0){
+            int end = i + 1;
+            while (end < m_batches.size() && m_batches[end].shader == batch.shader && m_batches[end].primitive->m_baseVertex >= 0) ++end;
+
+            if (currentGeometry != &m_geometry){
+                currentGeometry = &m_geometry;
+                ++stats.stateChanges;
+            }
+
+            m_geometry.Bind(m_instanceVBO);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)(i * sizeof(DrawCommand)), end - i, 0);
+
+            i = end;
+            continue;
+        }
+
+        if (currentGeometry != batch.primitive){
+            currentGeometry = batch.primitive;
+            ++stats.stateChanges;
+        }
+
+        batch.primitive->DrawInstanced(m_instanceVBO, batch.first, batch.count);
+        ++i;
+    }
+
+    state.SetCapability(GL_BLEND, false);
+    state.SetDepthMask(true);
+
+    stats.drawCalls += Replay(frame, bases);
+
+    if (gpuScene) m_gpuCulling->BuildHiZ(viewProjection);
+
+    stats.stateChangesSaved = unsortedChanges > stats.stateChanges ? unsortedChanges - stats.stateChanges : 0;
+
+    StateCache::Stats calls = state.GetStats();
+    stats.glCallsIssued = calls.issued;
+    stats.glCallsFiltered = calls.filtered;
+    state.ResetStats();
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats = stats;
+}
+
+// Projected diameter of the bounding sphere, boxes without bounds may fill the screen
+static float ProjectedSize(const glWrap::FramePacket& frame, const glWrap::AABB& bounds){
+    if (bounds.IsEmpty()) return (float)std::max(frame.size.x, frame.size.y);
+
+    float distance = frame.perspective ? std::max(glm::distance(bounds.GetCenter(), frame.cameraPosition), 1e-3f) : 1.0f;
+    return 2.0f * glm::length(bounds.GetExtent()) * frame.projectionScale / distance;
+}
+
+void glWrap::Window::RequireTextures(const FramePacket& frame){
+    auto require = [&](Shader* shader, float pixels){
+        for (auto& texture : shader->GetUniforms().textures) m_textureStreamer.Require(texture.second, pixels);
+    };
+
+    for (const FrameDraw& draw : frame.draws){
+        float pixels = ProjectedSize(frame, draw.bounds);
+
+        for (size_t i{}; i < draw.mesh->m_primitives.size(); ++i){
+            require(frame.shaders[frame.drawShaders[draw.shaders + i]].shader, pixels);
+        }
+    }
+
+    // The GPU culls the scene without telling which instances passed, the frustum's are taken instead
+    if (frame.gpuScene){
+        frame.gpuScene->Update();
+        m_streamQueue.clear();
+        frame.gpuScene->Cull(frame.culling ? frame.frustum : Frustum(), m_streamQueue);
+
+        for (Instance* instance : m_streamQueue){
+            float pixels = ProjectedSize(frame, instance->GetWorldBounds());
+
+            for (size_t p{}; p < instance->GetMesh()->m_primitives.size(); ++p){
+                require(instance->GetShader(p) ? instance->GetShader(p) : m_defaultShader.get(), pixels);
+            }
+        }
+    }
+
+    // Command buffers draw with their shader's textures and whatever they bound since
+    for (const CommandBuffer& buffer : frame.commandBuffers){
+        Shader* shader{nullptr};
+        std::map<int, Texture2D*> bound;
+
+        for (const CommandBuffer::Command& command : buffer.GetCommands()){
+            if (command.op == CommandBuffer::Op::UseShader){
+                shader = (Shader*)command.object;
+                bound.clear();
+            }
+            else if (command.op == CommandBuffer::Op::BindTexture) bound[command.slot] = (Texture2D*)command.object;
+            else if (command.op == CommandBuffer::Op::Draw && shader){
+                const AABB& primitiveBounds = ((Primitive*)command.object)->m_bounds;
+                float pixels{};
+
+                for (unsigned int i{}; i < command.count; ++i){
+                    pixels = std::max(pixels, ProjectedSize(frame, primitiveBounds.Transformed(buffer.GetTransforms()[command.first + i])));
+                }
+
+                require(shader, pixels);
+                for (auto& texture : bound) m_textureStreamer.Require(texture.second, pixels);
+            }
+        }
+    }
+}
+
+unsigned int glWrap::Window::Replay(const FramePacket& frame, const std::vector<unsigned int>& bases){
+    unsigned int drawCalls{};
+
+    for (size_t b{}; b < frame.commandBuffers.size(); ++b){
+        const CommandBuffer& buffer = frame.commandBuffers[b];
+        const float* values = buffer.GetValues().data();
+
+        for (const CommandBuffer::Command& command : buffer.GetCommands()){
+            switch (command.op){
+            case CommandBuffer::Op::UseShader:{
+                // Sent even when current, overrides of an earlier buffer must not carry over
+                const FrameShader* shader = FindShader(frame, (Shader*)command.object);
+                m_currentShader = shader->shader;
+                StateCache::Current().UseProgram(shader->program);
+                UpdateUniforms(frame, *shader);
+                break;
+            }
+            case CommandBuffer::Op::SetInt:
+                if (command.slot != -1){
+                    int value;
+                    std::memcpy(&value, values + command.first, sizeof(value));
+                    glUniform1i(command.slot, value);
+                }
+                break;
+            case CommandBuffer::Op::SetFloat:
+                if (command.slot != -1) glUniform1f(command.slot, values[command.first]);
+                break;
+            case CommandBuffer::Op::SetVec4:
+                if (command.slot != -1) glUniform4fv(command.slot, 1, values + command.first);
+                break;
+            case CommandBuffer::Op::SetMatrix4:
+                if (command.slot != -1) glUniformMatrix4fv(command.slot, 1, GL_FALSE, values + command.first);
+                break;
+            case CommandBuffer::Op::BindTexture:
+                ((Texture2D*)command.object)->SetActive(command.slot);
+                break;
+            case CommandBuffer::Op::BindTextureArray:
+                ((Texture2DArray*)command.object)->SetActive(command.slot);
+                break;
+            case CommandBuffer::Op::Draw:
+                if (!m_currentShader) break;
+                ((Primitive*)command.object)->DrawInstanced(m_instanceVBO, bases[b] + command.first, command.count);
+                ++drawCalls;
+                break;
+            }
+        }
+    }
+
+    return drawCalls;
+}
+
+glWrap::RenderStats glWrap::Window::GetRenderStats(){
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+void glWrap::Window::SetRenderThread(bool isTrue){
+    if (isTrue == m_renderThread.joinable()) return;
+
+    if (isTrue){
+        // Their results are published on this thread, which gives up the context
+        if (m_uploadThread.joinable() || m_pendingUploads || m_textureLoader.GetPending()){
+            DEV_LOG("Render thread refused while uploads or texture loads are pending for window ", m_name);
+            return;
+        }
+
+        glfwMakeContextCurrent(nullptr);
+        m_rendering = true;
+        m_renderThread = std::thread(&Window::RenderLoop, this);
+        return;
+    }
+
+    m_rendering = false;
+    { std::lock_guard<std::mutex> lock(m_packetMutex); }
+    m_packetReady.notify_one();
+    m_renderThread.join();
+
+    // The render thread changed GL state behind this thread's cache
+    glfwMakeContextCurrent(m_window);
+    StateCache::Current().Invalidate();
+}
+
+bool glWrap::Window::IsRenderThreaded(){ return m_renderThread.joinable(); }
+
+void glWrap::Window::SetCulling(bool isTrue){ m_culling = isTrue; }
+
+void glWrap::Window::SetOcclusionCulling(bool isTrue){
+    if (!isTrue) m_occlusion.reset();
+    else if (!m_occlusion) m_occlusion = std::make_unique<OcclusionBuffer>();
+}
+
+glWrap::OcclusionBuffer* glWrap::Window::GetOcclusionBuffer(){ return m_occlusion.get(); }
+void glWrap::Window::SetMultiDraw(bool isTrue){ m_multiDraw = isTrue && m_multiDrawSupported; }
+bool glWrap::Window::IsMultiDrawSupported(){ return m_multiDrawSupported; }
+
+void glWrap::Window::SetGpuCulling(bool isTrue){
+    if (!isTrue || !m_computeSupported){
+        m_gpuCulling.reset();
+        m_gpuScene = nullptr;
+    }
+    else if (!m_gpuCulling) m_gpuCulling = std::make_unique<GpuCulling>();
+}
+
+bool glWrap::Window::IsGpuCullingSupported(){ return m_computeSupported; }
+glWrap::GpuCulling* glWrap::Window::GetGpuCulling(){ return m_gpuCulling.get(); }
+
+bool glWrap::Window::IsKeyHeld(unsigned int key) { return glfwGetKey(m_window, key) == GLFW_PRESS; }
+bool glWrap::Window::IsRequestedClose() { return glfwWindowShouldClose(m_window); }
+
+float glWrap::Window::GetDeltaTime(){ return m_deltaTime; }
 
 void glWrap::Window::keyCall(GLFWwindow* window, int key, int scancode, int action, int mods){
     switch (action){
@@ -560,11 +5266,23 @@ void glWrap::Window::mousePosCall(GLFWwindow* window, double xpos, double ypos){
 */
 
 void glWrap::Window::frameCall(GLFWwindow* window, int width, int height){
-    glViewport(0, 0, width, height);
+    // A render thread applies the size of every frame packet itself
+    if (glfwGetCurrentContext() == window) StateCache::Current().SetViewport({0, 0, width, height});
     m_size = {width, height};
 }
 
-void glWrap::Window::LoadFile(std::map<std::string, Mesh>& container, std::string file){
+void glWrap::Window::SetJobSystem(JobSystem& jobs){
+    m_jobs = &jobs;
+    m_textureLoader.SetJobSystem(jobs);
+    m_textureStreamer.SetJobSystem(jobs);
+}
+
+glWrap::TextureLoader& glWrap::Window::GetTextureLoader(){ return m_textureLoader; }
+glWrap::TextureCache& glWrap::Window::GetTextureCache(){ return m_textureCache; }
+glWrap::TextureStreamer& glWrap::Window::GetTextureStreamer(){ return m_textureStreamer; }
+glWrap::JobSystem& glWrap::Window::GetJobSystem(){ return *m_jobs; }
+
+std::vector<std::pair<std::string, glWrap::Mesh>> glWrap::Window::ImportFile(const std::string& file, JobSystem& jobs){
 
     tinygltf::TinyGLTF loader;
     tinygltf::Model model;
@@ -585,53 +5303,218 @@ void glWrap::Window::LoadFile(std::map<std::string, Mesh>& container, std::strin
     }
     */
 
+    std::vector<std::pair<std::string, Mesh>> meshes(model.meshes.size());
+    JobCounter counter;
+
     for(int i{}; i < model.meshes.size(); ++i){
-        Mesh temp_mesh;
+        meshes[i].first = model.meshes[i].name;
+        meshes[i].second.m_primitives.resize(model.meshes[i].primitives.size());
+
+        for(int j{}; j < model.meshes[i].primitives.size(); ++j){
+            jobs.Run([&model, &meshes, i, j](){
+                Primitive& prim = meshes[i].second.m_primitives[j];
+
+                std::vector<float> position = GetAttributeData(model, model.meshes[i].primitives[j], "POSITION");
+                std::vector<float> normal = GetAttributeData(model, model.meshes[i].primitives[j], "NORMAL");
+                std::vector<float> texCoord = GetAttributeData(model, model.meshes[i].primitives[j], "TEXCOORD_0");
 
-        int postfix{0};
-        while (container.count(model.meshes[i].name + "." + std::to_string(postfix))){
-            ++postfix;
+                int floats = position.size() + normal.size() + texCoord.size();
+
+                std::vector<Vertex>& vertices = prim.m_vertices;
+
+                vertices.resize(floats / 8);
+
+                for (int x{}; x < vertices.size(); ++x){
+
+                    int posLoc = x * 3;
+                    int texLoc = x * 2;
+
+                    vertices[x].pos.x = position[0 + posLoc];
+                    vertices[x].pos.y = position[1 + posLoc];
+                    vertices[x].pos.z = position[2 + posLoc];
+                    vertices[x].nor.x = normal[0 + posLoc];
+                    vertices[x].nor.y = normal[1 + posLoc];
+                    vertices[x].nor.z = normal[2 + posLoc];
+                    vertices[x].tex.x = texCoord[0 + texLoc];
+                    vertices[x].tex.y = texCoord[1 + texLoc];
+                }
+
+                prim.m_indices = GetIndexData(model, model.meshes[i].primitives[j]);
+            }, &counter);
         }
+    }
 
-        for(int j{}; j < model.meshes[i].primitives.size(); ++j){
-            temp_mesh.m_primitives.push_back(Primitive());
+    jobs.Wait(counter);
 
-            Primitive& prim = temp_mesh.m_primitives.back();
+    for (auto& mesh : meshes) mesh.second.ComputeBounds();
+    return meshes;
+}
 
-            std::vector<float> position = GetAttributeData(model, model.meshes[i].primitives[j], "POSITION");
-            std::vector<float> normal = GetAttributeData(model, model.meshes[i].primitives[j], "NORMAL");
-            std::vector<float> texCoord = GetAttributeData(model, model.meshes[i].primitives[j], "TEXCOORD_0");
+void glWrap::Window::LoadFile(std::map<std::string, Mesh>& container, std::string file){ LoadFiles(container, {file}); }
 
-            int floats = position.size() + normal.size() + texCoord.size();
-            int testfloats = position.size() + normal.size() + texCoord.size() - 3;
+void glWrap::Window::LoadFiles(std::map<std::string, Mesh>& container, const std::vector<std::string>& files){
 
-            std::vector<Vertex>& vertices = prim.m_vertices;
+    std::vector<std::vector<std::pair<std::string, Mesh>>> imported(files.size());
+    JobCounter counter;
 
-            vertices.resize(floats / 8);
+    for (size_t i{}; i < files.size(); ++i){
+        m_jobs->Run([this, &imported, &files, i](){ imported[i] = ImportFile(files[i], *m_jobs); }, &counter);
+    }
 
-            for (int x{}; x < vertices.size(); ++x){
+    m_jobs->Wait(counter);
 
-                int posLoc = x * 3;
-                int texLoc = x * 2;
+    // GL objects can only be created on this thread
+    for (auto& meshes : imported){
+        for (auto& mesh : meshes){
+            int postfix{0};
+            while (container.count(mesh.first + "." + std::to_string(postfix))){
+                ++postfix;
+            }
 
-                vertices[x].pos.x = position[0 + posLoc];
-                vertices[x].pos.y = position[1 + posLoc];
-                vertices[x].pos.z = position[2 + posLoc];
-                vertices[x].nor.x = normal[0 + posLoc];
-                vertices[x].nor.y = normal[1 + posLoc];
-                vertices[x].nor.z = normal[2 + posLoc];
-                vertices[x].tex.x = texCoord[0 + texLoc];
-                vertices[x].tex.y = texCoord[1 + texLoc];
+            for (Primitive& prim : mesh.second.m_primitives){
+                CreateGlObjects(prim);
+                if (m_multiDraw) m_geometry.Add(prim);
             }
 
-            prim.m_indices = GetIndexData(model, model.meshes[i].primitives[j]);
+            container.insert({(mesh.first + "." + std::to_string(postfix)), mesh.second});
+        }
+    }
+}
 
-            CreateGlObjects(prim);
+void glWrap::Window::SetUploadThread(bool isTrue){
+    if (isTrue == m_uploadThread.joinable()) return;
 
-            }
-        container.insert({(model.meshes[i].name + "." + std::to_string(postfix)), temp_mesh});
+    if (isTrue){
+        if (m_renderThread.joinable()){
+            DEV_LOG("Upload thread refused while rendering on the render thread for window ", m_name);
+            return;
+        }
+
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        m_uploadWindow = glfwCreateWindow(1, 1, m_name.c_str(), NULL, m_window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+        if (!m_uploadWindow){
+            DEV_LOG("Failed to create upload context for window ", m_name);
+            return;
+        }
+
+        m_uploading = true;
+        m_uploadThread = std::thread(&Window::UploadLoop, this);
+        return;
     }
-    return;
+
+    // Queued work still runs, its results are published by the following Swaps
+    {
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
+        m_uploading = false;
+    }
+    m_uploadWake.notify_one();
+    m_uploadThread.join();
+
+    glfwDestroyWindow(m_uploadWindow);
+    m_uploadWindow = nullptr;
+}
+
+bool glWrap::Window::IsUploadThreaded(){ return m_uploadThread.joinable(); }
+unsigned int glWrap::Window::GetPendingUploads(){ return m_pendingUploads; }
+
+void glWrap::Window::Upload(std::function<void()> work, std::function<void()> publish){
+    if (m_renderThread.joinable()){
+        DEV_LOG("Upload dropped while rendering on the render thread for window ", m_name);
+        return;
+    }
+
+    if (!m_uploadThread.joinable()){
+        work();
+        if (publish) publish();
+        return;
+    }
+
+    ++m_pendingUploads;
+    {
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
+        m_uploadQueue.emplace_back(std::move(work), std::move(publish));
+    }
+    m_uploadWake.notify_one();
+}
+
+void glWrap::Window::UploadLoop(){
+    glfwMakeContextCurrent(m_uploadWindow);
+    StateCache::Current().Invalidate();
+
+    while (true){
+        std::pair<std::function<void()>, std::function<void()>> upload;
+        {
+            std::unique_lock<std::mutex> lock(m_uploadMutex);
+            m_uploadWake.wait(lock, [this]{ return !m_uploadQueue.empty() || !m_uploading; });
+            if (m_uploadQueue.empty()) break;
+
+            upload = std::move(m_uploadQueue.front());
+            m_uploadQueue.pop_front();
+        }
+
+        upload.first();
+
+        // Flushed so the fence can signal without this context doing anything else
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
+        m_uploadsDone.emplace_back(fence, std::move(upload.second));
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+void glWrap::Window::PollUploads(){
+    std::vector<std::function<void()>> ready;
+    {
+        // Fences signal in order, the first pending one ends the poll
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
+        while (!m_uploadsDone.empty()){
+            GLenum status = glClientWaitSync(m_uploadsDone.front().first, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+            glDeleteSync(m_uploadsDone.front().first);
+            ready.push_back(std::move(m_uploadsDone.front().second));
+            m_uploadsDone.pop_front();
+        }
+    }
+
+    for (std::function<void()>& publish : ready){
+        if (publish) publish();
+        --m_pendingUploads;
+    }
+}
+
+void glWrap::Window::LoadFileAsync(std::map<std::string, Mesh>& container, std::string file){
+    auto meshes = std::make_shared<std::vector<std::pair<std::string, Mesh>>>();
+
+    Upload([this, meshes, file](){
+        *meshes = ImportFile(file, *m_jobs);
+        for (auto& mesh : *meshes){
+            for (Primitive& prim : mesh.second.m_primitives) CreateBuffers(prim);
+        }
+    },
+    [meshes, &container](){
+        for (auto& mesh : *meshes){
+            int postfix{0};
+            while (container.count(mesh.first + "." + std::to_string(postfix))){
+                ++postfix;
+            }
+
+            for (Primitive& prim : mesh.second.m_primitives) CreateVertexArray(prim);
+            container.insert({(mesh.first + "." + std::to_string(postfix)), mesh.second});
+        }
+    });
+}
+
+void glWrap::Window::LoadTextureAsync(std::unique_ptr<Texture2D>& texture, std::string image, bool flip, GLenum filter, GLenum desiredChannels){
+    auto loaded = std::make_shared<std::unique_ptr<Texture2D>>();
+
+    Upload([loaded, image, flip, filter, desiredChannels](){ *loaded = std::make_unique<Texture2D>(image, flip, filter, desiredChannels); },
+           [loaded, &texture](){ texture = std::move(*loaded); });
 }
 
 bool glWrap::Window::IsKeyPressed(unsigned int key){ return std::count(m_pressedKeys.begin(), m_pressedKeys.end(), key); }
@@ -652,6 +5535,16 @@ void glWrap::Window::SetRequestedClose(bool should){ glfwSetWindowShouldClose(m_
 void glWrap::Window::SetInputMode(unsigned int mode, unsigned int value){ glfwSetInputMode(m_window, mode, value); }
 
 glWrap::Window::~Window(){
+    SetRenderThread(false);
+    SetUploadThread(false);
+    m_textureLoader.Release();
+    m_textureStreamer.Release();
+    m_textureCache.Collect();
+    StateCache::Current().DeleteBuffer(m_instanceVBO);
+    if (m_indirectBuffer) StateCache::Current().DeleteBuffer(m_indirectBuffer);
+    m_geometry.Release();
+    m_gpuCulling.reset();
+    SamplerCache::Clear();
     glfwTerminate();
 }
 
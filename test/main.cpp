@@ -54,9 +54,6 @@ int main(){
         camera.AddRotation({0.0f, 0.0f, window.GetDeltaMousePos().x * MouseSensitivity});
         camera.AddRotation({0.0f, window.GetDeltaMousePos().y * MouseSensitivity, 0.0f});
 
-        shader.SetMatrix4("model", instance.GetTransformMatrix());
-        shader.SetMatrix4("view", camera.GetView());
-        shader.SetMatrix4("projection", camera.GetProjection(window.GetSize()));
         window.Draw(instance);
 
         window.Swap();